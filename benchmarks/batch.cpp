@@ -0,0 +1,97 @@
+#include "timer.hpp"
+#include <bucket/batch.hpp>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using bucketlib::batch_lookup;
+using bucketlib::bucket;
+
+static volatile std::size_t sink; // prevent optimization
+
+/*
+One lookup on each of many independent buckets per step, as in ensemble
+simulations. The buckets together are much larger than the last-level cache,
+so every lookup misses. Compares a plain loop of find_upper_bound() with
+find_upper_bound_batch() at different numbers of lookups in flight.
+
+Every method gets its own fresh random lookups in every step, so no method
+finds the rows another one just touched in the cache, and the order of the
+methods rotates from step to step.
+
+Columns: method, buckets, elements per bucket, lookups per second.
+*/
+
+using Bucket = bucket<std::vector<double>>;
+
+template <std::size_t GROUP>
+double run_batch(const std::vector<batch_lookup<Bucket>> &lookups,
+                 std::vector<std::size_t> &out)
+{
+  MyTimer t{};
+  bucketlib::find_upper_bound_batch<GROUP>(lookups, out);
+  return t.get();
+}
+
+double run_loop(const std::vector<batch_lookup<Bucket>> &lookups,
+                std::vector<std::size_t> &out)
+{
+  MyTimer t{};
+  for (std::size_t i = 0; i < lookups.size(); i++)
+    out[i] = lookups[i].bucket->find_upper_bound(lookups[i].value);
+  return t.get();
+}
+
+int main()
+{
+  const std::size_t BUCKETS = 2'000;
+  const std::size_t N = 4'096;
+  const std::size_t STEPS = 20;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  std::vector<std::vector<double>> data(BUCKETS, std::vector<double>(N));
+  std::vector<std::unique_ptr<Bucket>> buckets;
+  for (auto &d : data)
+  {
+    for (double &x : d)
+      x = dist(rng);
+    buckets.push_back(std::make_unique<Bucket>(d));
+  }
+  std::vector<double> totals(BUCKETS);
+  for (std::size_t j = 0; j < BUCKETS; j++)
+    totals[j] = buckets[j]->get_total();
+
+  const char *names[] = {"loop", "batch_8", "batch_16", "batch_32"};
+  double (*methods[])(const std::vector<batch_lookup<Bucket>> &,
+                      std::vector<std::size_t> &) = {
+      run_loop, run_batch<8>, run_batch<16>, run_batch<32>};
+  constexpr std::size_t METHODS = 4;
+
+  std::cout << "method,buckets,elements,lookups_per_second" << std::endl;
+  std::vector<batch_lookup<Bucket>> lookups(BUCKETS);
+  std::vector<std::size_t> out(BUCKETS);
+  double durations[METHODS] = {};
+  for (std::size_t step = 0; step < STEPS; step++)
+  {
+    for (std::size_t k = 0; k < METHODS; k++)
+    {
+      // Fresh random buckets and values for every method. The totals are
+      // kept aside, so drawing the lookups does not touch the buckets.
+      for (std::size_t i = 0; i < BUCKETS; i++)
+      {
+        const std::size_t j = rng() % BUCKETS;
+        lookups[i] = {buckets[j].get(), dist(rng) * totals[j]};
+      }
+      const std::size_t m = (step + k) % METHODS;
+      durations[m] += methods[m](lookups, out);
+      sink = out[0];
+    }
+  }
+
+  const double total = static_cast<double>(BUCKETS * STEPS);
+  for (std::size_t m = 0; m < METHODS; m++)
+    std::cout << names[m] << "," << BUCKETS << "," << N << ","
+              << total / durations[m] << std::endl;
+}
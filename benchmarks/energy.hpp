@@ -0,0 +1,91 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+/*
+Energy counter based on the Linux powercap/RAPL interface.
+
+Reads the cumulative `energy_uj` counters of every top-level RAPL domain
+(/sys/class/powercap/intel-rapl:N, one per package; AMD packages are exposed
+under the same name). Sub-domains such as intel-rapl:0:0 are part of their
+package and are skipped to avoid counting them twice. A counter wraps from
+`max_energy_range_uj` to 0, which is corrected for.
+
+`joules_per_million()` turns a reading into the energy column every benchmark
+reports.
+
+If no domain is readable (no RAPL, a VM, or counters restricted to root),
+`available()` is false and `get()` returns NaN, so the harness keeps working.
+*/
+class MyEnergyMeter
+{
+  struct Domain
+  {
+    std::string counter;
+    std::uint64_t range;
+    std::uint64_t start;
+  };
+  std::vector<Domain> _domains;
+
+  static bool read(const std::string &path, std::uint64_t &value)
+  {
+    std::ifstream in(path);
+    return static_cast<bool>(in >> value);
+  }
+
+public:
+  MyEnergyMeter()
+  {
+    namespace fs = std::filesystem;
+    const fs::path root = "/sys/class/powercap";
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(root, ec))
+    {
+      const std::string name = entry.path().filename().string();
+      if (name.rfind("intel-rapl:", 0) != 0 ||
+          name.find(':', sizeof("intel-rapl:") - 1) != std::string::npos)
+        continue;
+
+      Domain domain{(entry.path() / "energy_uj").string(), 0, 0};
+      if (!read((entry.path() / "max_energy_range_uj").string(),
+                domain.range) ||
+          !read(domain.counter, domain.start))
+        continue;
+      _domains.push_back(domain);
+    }
+  }
+
+  bool available() const { return !_domains.empty(); }
+
+  /// Joules consumed by all packages since construction, or NaN.
+  double get() const
+  {
+    if (!available())
+      return std::numeric_limits<double>::quiet_NaN();
+
+    double joules = 0.0;
+    for (const Domain &domain : _domains)
+    {
+      std::uint64_t now;
+      if (!read(domain.counter, now))
+        return std::numeric_limits<double>::quiet_NaN();
+      const std::uint64_t delta =
+          now >= domain.start ? now - domain.start
+                              : (domain.range - domain.start) + now + 1;
+      joules += static_cast<double>(delta) * 1e-6;
+    }
+    return joules;
+  }
+};
+
+/// Joules per million iterations, NaN if energy is not measurable.
+inline double joules_per_million(double joules, std::size_t iterations)
+{
+  return joules * 1e6 / static_cast<double>(iterations);
+}
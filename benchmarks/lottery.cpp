@@ -0,0 +1,143 @@
+#include "timer.hpp"
+#include <bucket/lottery.hpp>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+using bucketlib::lottery_scheduler;
+
+static volatile std::size_t sink; // prevent optimization
+
+/*
+Throughput of the lottery scheduler against a stride scheduler built on a
+plain std::priority_queue.
+
+Every iteration picks a queue, removes one ticket from it (dequeue) and adds
+one ticket to a random queue (enqueue). The stride scheduler keeps one heap
+entry per queue; a ticket change pushes a fresh entry and stale entries are
+skipped when popped.
+
+The "lottery_mt" line moves the enqueues to 4 producer threads submitting
+per-thread batches, while the main thread picks and dequeues.
+
+Columns: scheduler, queues, iterations per second.
+*/
+
+void bench_lottery(std::size_t queues, std::size_t iterations)
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> queue_dist(0, queues - 1);
+  lottery_scheduler<std::int64_t> s(std::vector<std::int64_t>(queues, 4));
+
+  MyTimer t{};
+  for (std::size_t i = 0; i < iterations; i++)
+  {
+    const std::size_t q = s.pick(rng);
+    s.add_tickets(q, -1);
+    s.add_tickets(queue_dist(rng), 1);
+    sink = q;
+  }
+  const double duration = t.get();
+  std::cout << "lottery," << queues << "," << iterations / duration
+            << std::endl;
+}
+
+void bench_lottery_mt(std::size_t queues, std::size_t iterations)
+{
+  const std::size_t producers = 4;
+  lottery_scheduler<std::int64_t> s(std::vector<std::int64_t>(queues, 4));
+
+  MyTimer t{};
+  std::vector<std::thread> threads;
+  for (std::size_t p = 0; p < producers; p++)
+    threads.emplace_back(
+        [&, p]
+        {
+          std::mt19937 local(p);
+          std::uniform_int_distribution<std::size_t> queue_dist(0, queues - 1);
+          lottery_scheduler<std::int64_t>::batch b(s);
+          for (std::size_t i = p; i < iterations; i += producers)
+            b.add(queue_dist(local), 1);
+        });
+
+  std::mt19937 rng(42);
+  for (std::size_t i = 0; i < iterations; i++)
+  {
+    const std::size_t q = s.pick(rng);
+    if (q != lottery_scheduler<std::int64_t>::NOT_FOUND)
+      s.add_tickets(q, -1);
+    sink = q;
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  const double duration = t.get();
+  std::cout << "lottery_mt," << queues << "," << iterations / duration
+            << std::endl;
+}
+
+void bench_priority_queue(std::size_t queues, std::size_t iterations)
+{
+  struct entry
+  {
+    double pass;
+    std::size_t queue;
+    std::uint32_t version;
+    bool operator>(const entry &other) const { return pass > other.pass; }
+  };
+  constexpr double STRIDE = 1 << 20;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> queue_dist(0, queues - 1);
+  std::vector<std::int64_t> tickets(queues, 4);
+  std::vector<double> pass(queues, 0.0);
+  std::vector<std::uint32_t> version(queues, 0);
+  std::priority_queue<entry, std::vector<entry>, std::greater<>> heap;
+  for (std::size_t q = 0; q < queues; q++)
+    heap.push({STRIDE / tickets[q], q, 0});
+
+  auto change = [&](std::size_t q, std::int64_t delta)
+  {
+    tickets[q] += delta;
+    version[q]++;
+    if (tickets[q] > 0)
+      heap.push({pass[q] + STRIDE / tickets[q], q, version[q]});
+  };
+
+  MyTimer t{};
+  for (std::size_t i = 0; i < iterations; i++)
+  {
+    // Skip entries made stale by ticket changes.
+    while (heap.top().version != version[heap.top().queue])
+      heap.pop();
+    const entry top = heap.top();
+    heap.pop();
+    pass[top.queue] = top.pass;
+    version[top.queue]++;
+    if (tickets[top.queue] > 0)
+      heap.push({top.pass + STRIDE / tickets[top.queue], top.queue,
+                 version[top.queue]});
+
+    change(top.queue, -1);
+    change(queue_dist(rng), 1);
+    sink = top.queue;
+  }
+  const double duration = t.get();
+  std::cout << "priority_queue," << queues << "," << iterations / duration
+            << std::endl;
+}
+
+int main()
+{
+  const std::size_t ITER = 2'000'000;
+
+  std::cout << "scheduler,queues,iterations_per_second" << std::endl;
+  for (std::size_t queues : {1'000UL, 10'000UL, 100'000UL})
+  {
+    bench_lottery(queues, ITER);
+    bench_lottery_mt(queues, ITER);
+    bench_priority_queue(queues, ITER);
+  }
+}
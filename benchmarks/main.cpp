@@ -1,6 +1,7 @@
 // #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
 // #include <doctest/doctest.h>
 
+#include "energy.hpp"
 #include "timer.hpp"
 #include <bucket/bucket.hpp>
 #include <chrono>
@@ -24,6 +25,10 @@ For each test compare with a sequential approach.
 
 C) Modify first and last entry. Worst case scenario for both implementations.
 
+Next to the durations, every configuration reports the energy per million
+iterations (one iteration = the updates plus one upper-bound query) read from
+the RAPL counters, or nan where RAPL is unavailable.
+
 */
 
 std::size_t sequential_upper_bound(const std::vector<double> &data, double val)
@@ -55,6 +60,7 @@ void benchmark_A(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
   bucket<std::vector<double>> b(ROWS, COLS, data);
 
   //---------------------------
+  MyEnergyMeter e{};
   MyTimer t{};
   for (std::size_t i = 0; i < iterations; ++i)
   {
@@ -69,8 +75,10 @@ void benchmark_A(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
     sink = b.find_upper_bound(q);
   }
   auto duration = t.get();
+  auto energy = e.get();
 
   //---------------------------
+  MyEnergyMeter seq_e{};
   MyTimer seq{};
   std::vector<double> prefix(data.size() + 1, 0.0);
   for (std::size_t i = 0; i < iterations; ++i)
@@ -87,9 +95,11 @@ void benchmark_A(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
   }
 
   auto seq_duration = seq.get();
+  auto seq_energy = seq_e.get();
 
   std::cout << "A," << ROWS << "," << COLS << "," << duration << ","
-            << seq_duration << std::endl;
+            << seq_duration << "," << joules_per_million(energy, iterations)
+            << "," << joules_per_million(seq_energy, iterations) << std::endl;
 }
 
 void benchmark_B(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
@@ -106,6 +116,7 @@ void benchmark_B(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
 
   bucket<std::vector<double>> b(ROWS, COLS, data);
 
+  MyEnergyMeter e{};
   MyTimer t{};
   for (std::size_t i = 0; i < iterations; ++i)
   {
@@ -126,7 +137,9 @@ void benchmark_B(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
     sink = b.find_upper_bound(q);
   }
   auto duration = t.get();
+  auto energy = e.get();
 
+  MyEnergyMeter seq_e{};
   MyTimer seq{};
   std::vector<double> prefix(data.size() + 1, 0.0);
   for (std::size_t i = 0; i < iterations; ++i)
@@ -143,9 +156,11 @@ void benchmark_B(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
   }
 
   auto seq_duration = seq.get();
+  auto seq_energy = seq_e.get();
 
   std::cout << "B," << ROWS << "," << COLS << "," << duration << ","
-            << seq_duration << std::endl;
+            << seq_duration << "," << joules_per_million(energy, iterations)
+            << "," << joules_per_million(seq_energy, iterations) << std::endl;
 }
 
 void benchmark_C(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
@@ -162,6 +177,7 @@ void benchmark_C(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
 
   bucket<std::vector<double>> b(ROWS, COLS, data);
 
+  MyEnergyMeter e{};
   MyTimer t{};
   for (std::size_t i = 0; i < iterations; ++i)
   {
@@ -185,7 +201,9 @@ void benchmark_C(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
     sink = b.find_upper_bound(q);
   }
   auto duration = t.get();
+  auto energy = e.get();
 
+  MyEnergyMeter seq_e{};
   MyTimer seq{};
   std::vector<double> prefix(data.size() + 1, 0.0);
   for (std::size_t i = 0; i < iterations; ++i)
@@ -202,16 +220,23 @@ void benchmark_C(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
   }
 
   auto seq_duration = seq.get();
+  auto seq_energy = seq_e.get();
 
   std::cout << "C," << ROWS << "," << COLS << "," << duration << ","
-            << seq_duration << std::endl;
+            << seq_duration << "," << joules_per_million(energy, iterations)
+            << "," << joules_per_million(seq_energy, iterations) << std::endl;
 }
 
 int main()
 {
   constexpr std::size_t ITER = 100'000;
 
-  std::cout << "benchmark_type,rows,cols,bucket_duration,seq_duration"
+  if (!MyEnergyMeter{}.available())
+    std::cerr << "RAPL energy counters unavailable, energy columns are nan"
+              << std::endl;
+
+  std::cout << "benchmark_type,rows,cols,bucket_duration,seq_duration,"
+               "bucket_joules_per_million,seq_joules_per_million"
             << std::endl;
 
   std::size_t N = 1'000;
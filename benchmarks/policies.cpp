@@ -0,0 +1,110 @@
+#include "energy.hpp"
+#include "timer.hpp"
+#include <bucket/bucket.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using bucketlib::bucket;
+namespace policy = bucketlib::policy;
+
+static volatile std::size_t sink; // prevent optimization
+
+/*
+Policy matrix: the random-access benchmark (A) of main.cpp, run for a number
+of compile-time policy combinations of `bucket`. Every combination sees the
+same sequence of updates and queries.
+
+The columns follow main.cpp: the policy combination as benchmark_type, rows,
+cols, the duration in seconds and the RAPL energy per million iterations (nan
+where RAPL is unavailable). There is no sequential baseline; the "default"
+combination is the reference.
+*/
+
+template <typename Bucket>
+void benchmark_policy(const std::string &name, std::size_t ROWS,
+                      std::size_t COLS, std::size_t iterations)
+{
+  const std::size_t N = ROWS * COLS;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> idx_dist(0, N - 1);
+  std::uniform_real_distribution<double> val_dist(0.0, 1.0);
+
+  std::vector<double> data(N);
+  for (auto &x : data)
+    x = val_dist(rng);
+
+  Bucket b(ROWS, COLS, data);
+
+  MyEnergyMeter e{};
+  MyTimer t{};
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    std::size_t idx = idx_dist(rng);
+    data[idx] = val_dist(rng);
+
+    b.update_sum_at_row(idx / COLS);
+    if (!b.is_lazy_refresh())
+      b.refresh_cumsum();
+
+    double q = val_dist(rng) * b.get_total();
+    sink = b.find_upper_bound(q);
+  }
+  auto duration = t.get();
+  auto energy = e.get();
+
+  std::cout << name << "," << ROWS << "," << COLS << "," << duration << ","
+            << joules_per_million(energy, iterations) << std::endl;
+}
+
+using Data = std::vector<double>;
+
+void run_matrix(std::size_t ROWS, std::size_t COLS, std::size_t iterations)
+{
+  benchmark_policy<bucket<Data>>("default", ROWS, COLS, iterations);
+  benchmark_policy<bucket<Data, policy::aligned_storage>>(
+      "aligned_storage", ROWS, COLS, iterations);
+  benchmark_policy<bucket<Data, policy::vector_storage,
+                          policy::blocked_row_search<>>>("blocked_row", ROWS,
+                                                         COLS, iterations);
+  benchmark_policy<bucket<Data, policy::vector_storage,
+                          policy::heavy_first_row_search>>(
+      "heavy_first_row", ROWS, COLS, iterations);
+  benchmark_policy<bucket<Data, policy::vector_storage,
+                          policy::linear_row_search,
+                          policy::branchless_top_search,
+                          policy::eager_refresh>>("branchless_top", ROWS,
+                                                  COLS, iterations);
+  benchmark_policy<bucket<Data, policy::vector_storage,
+                          policy::linear_row_search, policy::linear_top_search,
+                          policy::eager_refresh>>("linear_top", ROWS, COLS,
+                                                  iterations);
+  benchmark_policy<bucket<Data, policy::vector_storage,
+                          policy::linear_row_search, policy::binary_top_search,
+                          policy::lazy_refresh>>("lazy_refresh", ROWS, COLS,
+                                                 iterations);
+  benchmark_policy<bucket<Data, policy::aligned_storage,
+                          policy::blocked_row_search<>,
+                          policy::branchless_top_search,
+                          policy::lazy_refresh>>(
+      "aligned+blocked+branchless+lazy", ROWS, COLS, iterations);
+}
+
+int main()
+{
+  const std::size_t ITER = 1'000'000;
+
+  if (!MyEnergyMeter{}.available())
+    std::cerr << "RAPL energy counters unavailable, energy columns are nan"
+              << std::endl;
+
+  std::cout << "benchmark_type,rows,cols,bucket_duration,"
+               "bucket_joules_per_million"
+            << std::endl;
+
+  for (std::size_t N : {10'000UL, 1'000'000UL})
+    for (std::size_t ROWS : {N / 256, N / 64, N / 16})
+      run_matrix(ROWS, N / ROWS, ITER);
+}
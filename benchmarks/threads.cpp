@@ -0,0 +1,415 @@
+#include "energy.hpp"
+#include "timer.hpp"
+#include <bucket/bucket.hpp>
+#include <bucket/concurrent.hpp>
+#include <bucket/lottery.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using bucketlib::bucket;
+using bucketlib::concurrent_bucket;
+using bucketlib::lottery_scheduler;
+
+static volatile std::size_t sink; // prevent optimization
+
+/*
+Contention and scaling of concurrent bucket use at 1..N threads.
+
+Configurations:
+  swmr_locked         thread 0 updates (with probability update_ratio, else
+                      queries), all others only query; one bucket behind a
+                      std::shared_mutex.
+  swmr_concurrent     the same roles on a concurrent_bucket, without locks.
+  disjoint_locked     every thread mixes updates and queries by update_ratio;
+                      updates stay in the thread's own rows. One bucket
+                      behind a std::shared_mutex (the refresh is global).
+  disjoint_concurrent the same on a concurrent_bucket, without locks.
+  sharded             every thread owns a bucket over its own slice of the
+                      weights and mixes updates and queries on it.
+  pipelined           threads 1.. only enqueue ticket deltas into per-thread
+                      lottery_scheduler batches; thread 0 only picks (which
+                      applies the submitted batches). With one thread, it
+                      mixes both by update_ratio.
+
+Threads are pinned to the CPUs this process may run on, either "compact"
+(filling one socket first) or "spread" (round-robin over sockets, only run if
+there is more than one). Threads beyond the CPU count share CPUs. The sockets
+column counts the sockets the threads ran on. One operation in LATENCY_STRIDE
+is timed on its own for the latency percentiles.
+
+Usage: bucket_thread_bench [max_threads] [update_ratio] [ops_per_thread]
+
+The columns start as in main.cpp: benchmark_type, rows and cols of the
+bucket (of each shard for "sharded"). Then come threads, placement, sockets,
+update_ratio, the duration in seconds, operations per second, the
+p50/p99/p99.9 operation latency in nanoseconds and the RAPL energy per million
+operations (nan where RAPL is unavailable).
+*/
+
+constexpr std::size_t N = 1 << 18;
+constexpr std::size_t LATENCY_STRIDE = 8;
+
+using Bucket = bucket<std::vector<double>>;
+
+struct cpu_info
+{
+  int cpu;
+  int socket;
+};
+
+// The CPUs this process may run on, with their physical package.
+std::vector<cpu_info> available_cpus()
+{
+  std::vector<cpu_info> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+      if (!CPU_ISSET(cpu, &set))
+        continue;
+      int socket = 0;
+      std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                       "/topology/physical_package_id");
+      in >> socket;
+      cpus.push_back({cpu, socket});
+    }
+#endif
+  if (cpus.empty())
+    cpus.push_back({-1, 0});
+  return cpus;
+}
+
+// Order in which threads are assigned to CPUs.
+std::vector<cpu_info> placement_order(std::vector<cpu_info> cpus, bool spread)
+{
+  std::stable_sort(cpus.begin(), cpus.end(), [](const cpu_info &a,
+                                                const cpu_info &b)
+                   { return a.socket < b.socket; });
+  if (!spread)
+    return cpus;
+
+  std::vector<std::vector<cpu_info>> sockets;
+  for (const cpu_info &c : cpus)
+  {
+    if (sockets.empty() || sockets.back().front().socket != c.socket)
+      sockets.emplace_back();
+    sockets.back().push_back(c);
+  }
+  std::vector<cpu_info> order;
+  for (std::size_t k = 0; order.size() < cpus.size(); k++)
+    for (const auto &s : sockets)
+      if (k < s.size())
+        order.push_back(s[k]);
+  return order;
+}
+
+void pin_to(int cpu)
+{
+#ifdef __linux__
+  if (cpu < 0)
+    return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)cpu;
+#endif
+}
+
+struct config
+{
+  std::size_t threads;
+  double update_ratio;
+  std::size_t ops;
+  const char *placement;
+  const std::vector<cpu_info> *order;
+};
+
+/*
+Runs op(thread, rng) `cfg.ops` times on each of `cfg.threads` pinned threads,
+all released together, and prints one CSV line for a rows × cols bucket.
+*/
+template <typename Op>
+void run(const char *name, std::size_t rows, std::size_t cols,
+         const config &cfg, Op op)
+{
+  const std::vector<cpu_info> &order = *cfg.order;
+  std::set<int> sockets;
+  for (std::size_t t = 0; t < cfg.threads; t++)
+    sockets.insert(order[t % order.size()].socket);
+
+  std::vector<std::vector<double>> latencies(cfg.threads);
+  // The clock starts once every thread is ready, and before any is released,
+  // so a late wake-up of this thread cannot hide work.
+  std::latch ready(static_cast<std::ptrdiff_t>(cfg.threads));
+  std::latch start(1);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < cfg.threads; t++)
+    threads.emplace_back(
+        [&, t]
+        {
+          pin_to(order[t % order.size()].cpu);
+          std::mt19937_64 rng(t + 1);
+          std::vector<double> &lat = latencies[t];
+          lat.reserve(cfg.ops / LATENCY_STRIDE + 1);
+          ready.count_down();
+          start.wait();
+          for (std::size_t i = 0; i < cfg.ops; i++)
+          {
+            if (i % LATENCY_STRIDE != 0)
+            {
+              op(t, rng);
+              continue;
+            }
+            const auto before = std::chrono::steady_clock::now();
+            op(t, rng);
+            const auto after = std::chrono::steady_clock::now();
+            lat.push_back(
+                std::chrono::duration<double, std::nano>(after - before)
+                    .count());
+          }
+        });
+
+  ready.wait();
+  MyEnergyMeter energy{};
+  MyTimer timer{};
+  start.count_down();
+  for (std::thread &t : threads)
+    t.join();
+  const double duration = timer.get();
+  const double joules = energy.get();
+
+  std::vector<double> all;
+  for (const auto &lat : latencies)
+    all.insert(all.end(), lat.begin(), lat.end());
+  auto percentile = [&](double p)
+  {
+    if (all.empty())
+      return 0.0;
+    const std::size_t k = std::min(
+        all.size() - 1, static_cast<std::size_t>(p * all.size()));
+    std::nth_element(all.begin(), all.begin() + k, all.end());
+    return all[k];
+  };
+
+  const std::size_t total_ops = cfg.threads * cfg.ops;
+  std::cout << name << "," << rows << "," << cols << "," << cfg.threads << ","
+            << cfg.placement << "," << sockets.size() << ","
+            << cfg.update_ratio << "," << duration << ","
+            << total_ops / duration << "," << percentile(0.5) << ","
+            << percentile(0.99) << "," << percentile(0.999) << ","
+            << joules_per_million(joules, total_ops) << std::endl;
+}
+
+std::vector<double> make_weights(std::size_t n)
+{
+  std::mt19937_64 rng(1337);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  std::vector<double> w(n);
+  for (double &x : w)
+    x = dist(rng);
+  return w;
+}
+
+// Updates and queries of one bucket behind a reader-writer lock. `owned`
+// restricts thread t's updates to its own rows; otherwise only thread 0
+// updates.
+void bench_locked(const char *name, const config &cfg, bool owned)
+{
+  std::vector<double> data = make_weights(N);
+  Bucket b(data);
+  std::shared_mutex mutex;
+  const std::size_t rows = b.get_rows();
+  const std::size_t cols = b.get_cols();
+
+  run(name, rows, cols, cfg,
+      [&](std::size_t t, std::mt19937_64 &rng)
+      {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        const bool writer = owned || t == 0;
+        if (writer && dist(rng) < cfg.update_ratio)
+        {
+          std::size_t row = rng() % rows;
+          if (owned)
+          {
+            const std::size_t share =
+                std::max<std::size_t>(rows / cfg.threads, 1);
+            row = std::min(t * share + row % share, rows - 1);
+          }
+          const std::size_t i = std::min(row * cols + rng() % cols, N - 1);
+          const double w = dist(rng);
+          std::unique_lock lock(mutex);
+          data[i] = w;
+          b.update_sum_at_row(i / cols);
+          b.refresh_cumsum();
+        }
+        else
+        {
+          std::shared_lock lock(mutex);
+          sink = b.sample(rng);
+        }
+      });
+}
+
+// The same roles on a concurrent_bucket, without locks.
+void bench_concurrent(const char *name, const config &cfg, bool owned)
+{
+  std::vector<double> data = make_weights(N);
+  concurrent_bucket<double> b(data);
+  const std::size_t rows = b.get_rows();
+  const std::size_t cols = b.get_cols();
+
+  run(name, rows, cols, cfg,
+      [&](std::size_t t, std::mt19937_64 &rng)
+      {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        const bool writer = owned || t == 0;
+        if (writer && dist(rng) < cfg.update_ratio)
+        {
+          std::size_t row = rng() % rows;
+          if (owned)
+          {
+            const std::size_t share =
+                std::max<std::size_t>(rows / cfg.threads, 1);
+            row = std::min(t * share + row % share, rows - 1);
+          }
+          b.set(std::min(row * cols + rng() % cols, N - 1), dist(rng));
+        }
+        else
+          sink = b.sample(rng);
+      });
+}
+
+// One private bucket per thread over N / threads weights.
+void bench_sharded(const config &cfg)
+{
+  const std::size_t shard = std::max<std::size_t>(N / cfg.threads, 1);
+  std::vector<std::vector<double>> data(cfg.threads);
+  std::vector<std::unique_ptr<Bucket>> buckets;
+  for (std::size_t t = 0; t < cfg.threads; t++)
+  {
+    data[t] = make_weights(shard);
+    buckets.push_back(std::make_unique<Bucket>(data[t]));
+  }
+
+  run("sharded", buckets[0]->get_rows(), buckets[0]->get_cols(), cfg,
+      [&](std::size_t t, std::mt19937_64 &rng)
+      {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        Bucket &b = *buckets[t];
+        if (dist(rng) < cfg.update_ratio)
+        {
+          const std::size_t i = rng() % shard;
+          data[t][i] = dist(rng);
+          b.update_sum_at_row(i / b.get_cols());
+          b.refresh_cumsum();
+        }
+        else
+          sink = b.sample(rng);
+      });
+}
+
+// Producers hand ticket deltas to the picking thread in batches.
+void bench_pipelined(const config &cfg)
+{
+  lottery_scheduler<std::int64_t> s(N, 4);
+  std::vector<std::unique_ptr<lottery_scheduler<std::int64_t>::batch>> batches;
+  for (std::size_t t = 0; t < cfg.threads; t++)
+    batches.push_back(
+        std::make_unique<lottery_scheduler<std::int64_t>::batch>(s, 64));
+
+  run("pipelined", Bucket::default_rows(N), Bucket::default_cols(N), cfg,
+      [&](std::size_t t, std::mt19937_64 &rng)
+      {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        const bool update = cfg.threads == 1 ? dist(rng) < cfg.update_ratio
+                                             : t != 0;
+        if (update)
+        {
+          if (cfg.threads == 1)
+            s.add_tickets(rng() % N, 1);
+          else
+            batches[t]->add(rng() % N, 1);
+        }
+        else
+        {
+          const std::size_t q = s.pick(rng);
+          if (q != s.NOT_FOUND)
+            s.add_tickets(q, -1);
+          sink = q;
+        }
+      });
+  batches.clear();
+}
+
+int main(int argc, char **argv)
+{
+  const std::size_t max_threads = std::max<std::size_t>(
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+               : std::thread::hardware_concurrency(),
+      1);
+  const double update_ratio = argc > 2 ? std::strtod(argv[2], nullptr) : 0.1;
+  const std::size_t ops =
+      argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 200'000;
+
+  const std::vector<cpu_info> cpus = available_cpus();
+  std::set<int> sockets;
+  for (const cpu_info &c : cpus)
+    sockets.insert(c.socket);
+  const std::vector<cpu_info> compact = placement_order(cpus, false);
+  const std::vector<cpu_info> spread = placement_order(cpus, true);
+
+  if (!MyEnergyMeter{}.available())
+    std::cerr << "RAPL energy counters unavailable, energy columns are nan"
+              << std::endl;
+
+  std::cout << "benchmark_type,rows,cols,threads,placement,sockets,"
+               "update_ratio,bucket_duration,ops_per_second,p50_ns,p99_ns,"
+               "p999_ns,bucket_joules_per_million"
+            << std::endl;
+  // Powers of two below max_threads, then max_threads itself.
+  std::vector<std::size_t> counts;
+  for (std::size_t threads = 1; threads < max_threads; threads *= 2)
+    counts.push_back(threads);
+  counts.push_back(max_threads);
+
+  for (std::size_t threads : counts)
+  {
+    for (bool spread_run : {false, true})
+    {
+      if (spread_run && sockets.size() < 2)
+        continue;
+      const config cfg{threads, update_ratio, ops,
+                       spread_run ? "spread" : "compact",
+                       spread_run ? &spread : &compact};
+      bench_locked("swmr_locked", cfg, false);
+      bench_concurrent("swmr_concurrent", cfg, false);
+      bench_locked("disjoint_locked", cfg, true);
+      bench_concurrent("disjoint_concurrent", cfg, true);
+      bench_sharded(cfg);
+      bench_pipelined(cfg);
+    }
+  }
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <ranges>
+#include <span>
+#include <type_traits>
+
+namespace bucketlib
+{
+
+/// @brief One lookup of a batch: `bucket->find_upper_bound(value)`.
+template <typename Bucket> struct batch_lookup
+{
+  const Bucket *bucket;
+  typename Bucket::value_type value;
+};
+
+namespace detail
+{
+inline void prefetch(const void *address) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address);
+#else
+  static_cast<void>(address);
+#endif
+}
+} // namespace detail
+
+/**
+ * @brief Runs many independent `find_upper_bound()` lookups, possibly on
+ * different buckets, with their cache misses overlapped.
+ *
+ * One lookup on a cold bucket stalls on a miss at almost every step of the
+ * binary search over `get_cumsums()` and again on the data row. Here up to
+ * `GROUP` lookups are in flight at once, each as a small state machine
+ * (asynchronous memory access chaining, AMAC). A lookup does one step, i.e.
+ * one probe of its (branchless) binary search or the scan of its row,
+ * prefetches the address its next step will read, and yields to the next
+ * lookup in the group. By the time it is resumed the line has usually
+ * arrived, so `GROUP` misses overlap instead of being paid one after another.
+ * Finished lookups are replaced by new ones from the batch right away.
+ *
+ * Results are identical to calling `find_upper_bound()` on each lookup, for
+ * every row search policy, since rows are scanned with the bucket's own
+ * `row_search_policy`.
+ * Lazy buckets with pending updates are refreshed first. Heavy-first buckets
+ * are looked up directly, as their row scans follow the permutation.
+ *
+ * @tparam GROUP Number of lookups in flight (about the number of outstanding
+ * misses the core supports, 8 to 16)
+ * @param lookups The (bucket, value) pairs, each value valid for
+ * `find_upper_bound()` of its bucket
+ * @param out One result per lookup (index or NOT_FOUND), at least as many
+ * entries as `lookups`
+ * @throws std::runtime_error if ENABLE_CHECKS is defined and `out` is smaller
+ * than `lookups`
+ */
+template <std::size_t GROUP = 16, typename Bucket>
+void find_upper_bound_batch(std::span<const batch_lookup<Bucket>> lookups,
+                            std::span<std::size_t> out)
+{
+  using value_type = typename Bucket::value_type;
+  static_assert(GROUP > 0, "At least one lookup must be in flight");
+  VAL_CHECK(out.size() >= lookups.size(),
+            "In batched upper limit, fewer outputs than lookups")
+
+  struct slot
+  {
+    std::size_t lookup;
+    // Search window [first, first + length) over the row ends cums[1, rows].
+    const value_type *ends;
+    std::size_t first;
+    std::size_t length; // 0 once the row is found
+    bool active = false;
+  };
+  std::array<slot, GROUP> slots{};
+  std::size_t next = 0;
+
+  // Starts the next lookup needing a search in `s`. Returns false when the
+  // batch is exhausted.
+  auto start = [&](slot &s)
+  {
+    for (; next < lookups.size(); next++)
+    {
+      const batch_lookup<Bucket> &l = lookups[next];
+      if (l.bucket->is_heavy_first())
+      {
+        out[next] = l.bucket->find_upper_bound(l.value);
+        continue;
+      }
+      if (l.bucket->is_lazy_refresh() &&
+          l.bucket->get_min_row_affected() < l.bucket->get_rows())
+        l.bucket->refresh_cumsum();
+
+      s = {next++, l.bucket->get_cumsums().data() + 1, 0,
+           l.bucket->get_rows(), true};
+      detail::prefetch(s.ends + s.length / 2);
+      return true;
+    }
+    s.active = false;
+    return false;
+  };
+
+  std::size_t active = 0;
+  for (slot &s : slots)
+    active += start(s);
+
+  while (active > 0)
+  {
+    for (slot &s : slots)
+    {
+      if (!s.active)
+        continue;
+      const batch_lookup<Bucket> &l = lookups[s.lookup];
+
+      if (s.length > 1)
+      {
+        // One probe of the branchless binary search, then prefetch the next.
+        const std::size_t half = s.length / 2;
+        s.first = detail::reached(l.value, s.ends[s.first + half])
+                      ? s.first
+                      : s.first + half;
+        s.length -= half;
+        detail::prefetch(s.ends + s.first + s.length / 2);
+        continue;
+      }
+
+      if (s.length == 1)
+      {
+        // Settle the row, then prefetch the head of its data.
+        const std::size_t rows = l.bucket->get_rows();
+        if (!detail::reached(l.value, s.ends[s.first]))
+          s.first++;
+        s.first = std::min(s.first, rows - 1);
+        s.length = 0;
+        const std::size_t row = s.first;
+        const value_type *data =
+            std::ranges::data(l.bucket->get_container()) +
+            row * l.bucket->get_cols();
+        const std::size_t bytes =
+            l.bucket->get_row_length(row) * sizeof(value_type);
+        for (std::size_t line = 0; line < std::min<std::size_t>(bytes, 512);
+             line += 64)
+          detail::prefetch(reinterpret_cast<const char *>(data) + line);
+        continue;
+      }
+
+      // Scan the row in its natural order, with the bucket's own row search.
+      const std::size_t row = s.first;
+      const std::size_t cols = l.bucket->get_cols();
+      const value_type *data =
+          std::ranges::data(l.bucket->get_container()) + row * cols;
+      const std::size_t length = l.bucket->get_row_length(row);
+      const std::size_t hit = Bucket::row_search_policy::scan(
+          data, length, (s.ends - 1)[row], l.value); // from cums[row]
+      out[s.lookup] = hit < length ? row * cols + hit : Bucket::NOT_FOUND;
+      if (!start(s))
+        active--;
+    }
+  }
+}
+
+/// @brief `find_upper_bound_batch()` for a vector of lookups.
+template <std::size_t GROUP = 16, typename Bucket>
+void find_upper_bound_batch(const std::vector<batch_lookup<Bucket>> &lookups,
+                            std::span<std::size_t> out)
+{
+  find_upper_bound_batch<GROUP, Bucket>(
+      std::span<const batch_lookup<Bucket>>(lookups), out);
+}
+} // namespace bucketlib
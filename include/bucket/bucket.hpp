@@ -1,14 +1,24 @@
 #pragma once
 
+#include <bucket/philox.hpp>
+#include <bucket/policies.hpp>
+
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <random>
+#include <ranges>
 #include <span>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #ifdef ENABLE_CHECKS
@@ -32,27 +42,45 @@
 namespace bucketlib
 {
 
-template <typename Container> struct is_supported_container : std::false_type
-{
-};
-
-template <typename T>
-struct is_supported_container<std::vector<T>> : std::true_type
-{
-};
+/**
+ * @brief Any sized range whose elements are stored contiguously, e.g.
+ * `std::vector<T, Alloc>` with any allocator, `std::pmr::vector<T>`,
+ * `std::array<T, N>`, `std::span<T>` or a custom small-vector type.
+ */
+template <typename Container>
+concept RandomAccessContainer = std::ranges::contiguous_range<Container> &&
+                                std::ranges::sized_range<Container>;
 
-template <typename T, std::size_t N>
-struct is_supported_container<std::array<T, N>> : std::true_type
+/**
+ * @brief Guaranteed alignment (in bytes) of the first element of a container.
+ *
+ * Defaults to the alignment of the element type. Containers whose allocator
+ * advertises a static `alignment` member (the usual convention for aligned
+ * allocators) get that alignment. Specialize this trait for other containers
+ * with a known over-alignment.
+ */
+template <typename Container> struct container_alignment
 {
+  static constexpr std::size_t value =
+      alignof(std::ranges::range_value_t<Container>);
 };
 
-template <typename T>
-struct is_supported_container<std::span<T>> : std::true_type
+template <typename Container>
+  requires requires {
+    {
+      Container::allocator_type::alignment
+    } -> std::convertible_to<std::size_t>;
+  }
+struct container_alignment<Container>
 {
+  static constexpr std::size_t value =
+      std::max<std::size_t>(Container::allocator_type::alignment,
+                            alignof(std::ranges::range_value_t<Container>));
 };
 
 template <typename Container>
-concept RandomAccessContainer = is_supported_container<Container>::value;
+inline constexpr std::size_t container_alignment_v =
+    container_alignment<Container>::value;
 
 template <typename T>
 concept ConvertibleToSizeT =
@@ -66,8 +94,72 @@ concept Numeric = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
 
 // NRA stands for Numeric Random Access Container
 template <typename Container>
-concept NRAContainer =
-    RandomAccessContainer<Container> && Numeric<typename Container::value_type>;
+concept NRAContainer = RandomAccessContainer<Container> &&
+                       Numeric<std::ranges::range_value_t<Container>>;
+
+namespace detail
+{
+/**
+ * @brief Whether a row whose cumulative sum ends at `cum` contains `val`.
+ *
+ * Integral weights are exact, so a row ending exactly at `val` contains it
+ * (consistent with the `>=` of the in-row scan). Floating point row ends are
+ * rounded differently from the in-row running sum, so the boundary goes to
+ * the next row, whose scan is then guaranteed to reach `val`.
+ *
+ * Shared by every structure that searches cumulative sums like `bucket`.
+ */
+template <typename T>
+constexpr bool reached(const T &val, const T &cum) noexcept
+{
+  if constexpr (std::is_integral_v<T>)
+    return val <= cum;
+  else
+    return val < cum;
+}
+
+/**
+ * @brief Draws the search value of one sample over weights of positive
+ * `total`: uniform in `[1, total]` for integral weights, in `(0, total)`
+ * otherwise.
+ */
+template <typename T, std::uniform_random_bit_generator URBG>
+T draw_target(URBG &rng, const T &total)
+{
+  if constexpr (std::is_integral_v<T>)
+  {
+    std::uniform_int_distribution<unsigned long long> dist(
+        1, static_cast<unsigned long long>(total));
+    return static_cast<T>(dist(rng));
+  }
+  else
+  {
+    T val;
+    do
+    {
+      val = std::generate_canonical<T, std::numeric_limits<T>::digits>(rng) *
+            total;
+    } while (!(val > 0 && val < total));
+    return val;
+  }
+}
+
+/**
+ * @brief Returns the position of the last positive of the `length` weights
+ * at `first`, or `length` if none is positive.
+ *
+ * The answer to a target that a cumulative sum reaches but a differently
+ * rounded running sum misses by a few ulps.
+ */
+template <typename T>
+std::size_t last_positive(const T *first, std::size_t length) noexcept
+{
+  for (std::size_t i = length; i-- > 0;)
+    if (first[i] > 0)
+      return i;
+  return length;
+}
+} // namespace detail
 
 /**
  * @brief A 2D manager abstraction for efficient cumulative operations and
@@ -101,37 +193,127 @@ concept NRAContainer =
  *
  * In addition, the class supports:
  *  - Efficient incremental updates to `_p_sums` and `_p_cum_sums`
- *  - Fast inverse transform sampling via `find_upper_bound(val)`
+ *  - Fast inverse transform sampling via `find_upper_bound(val)`, `sample(rng)`
+ *    and multinomial draws of many samples via `sample_counts(k, rng)`
+ *  - Reproducible batch sampling with counter-based streams
+ *    (`sample_many(out, stream, first_draw)`)
+ *  - An optional lazy refresh mode (`set_lazy_refresh(true)`) in which the
+ *    cumulative sums are only brought up to date, on demand, as far as the
+ *    row a query lands in
+ *  - An optional `float` mirror of `_p_cum_sums` for `double` buckets
+ *    (`set_float_mirror(true)`) halving the memory traffic of the row search
+ *  - An optional floating-point drift monitor (`set_drift_tolerance(tol)`)
+ *    re-summing only the blocks of `_p_cum_sums` whose error bound grew too
+ *    large
+ *  - Incremental rebuilds (`begin_rebuild()`), optionally into a new shape,
+ *    computed a few rows per update into shadow sums that are swapped in
+ *    once complete
+ *  - An optional heavy-first layout (`set_heavy_first(true)`) in which every
+ *    row is scanned in descending order of weight, shortening the expected
+ *    linear scan when the mass of a row is concentrated in a few elements
  *
- * @tparam Container Must be a supported contiguous random-access container:
- *         - `std::vector<T>`
+ * @tparam Container Any sized contiguous range of arithmetic values, e.g.:
+ *         - `std::vector<T, Alloc>` (including `std::pmr::vector<T>`)
  *         - `std::array<T, N>`
  *         - `std::span<T>`
+ *         - custom small-vector types
+ *         Over-aligned storage (see `container_alignment`) is exploited by
+ *         the row kernels when rows start on aligned boundaries.
+ * @tparam StoragePolicy Containers of the row and cumulative sums, e.g.
+ *         `policy::vector_storage` or `policy::aligned_storage`
+ * @tparam RowSearchPolicy In-row scan and row layout, e.g.
+ *         `policy::linear_row_search` (heavy-first selectable at runtime),
+ *         `policy::heavy_first_row_search` or `policy::blocked_row_search<>`
+ * @tparam TopSearchPolicy Search over the cumulative sums, e.g.
+ *         `policy::mirrored_binary_top_search` (`float` mirror selectable at
+ *         runtime), `policy::binary_top_search`,
+ *         `policy::branchless_top_search` or `policy::linear_top_search`
+ * @tparam RefreshPolicy `policy::configurable_refresh` (lazy mode selectable
+ *         at runtime), `policy::eager_refresh` or `policy::lazy_refresh`
+ * @tparam StatsPolicy `policy::no_stats` or `policy::counting_stats`
+ *
+ * The defaults give the behavior described above. Policies fixed at compile
+ * time drop the corresponding runtime checks, and the setters of features
+ * they exclude are not available (see `bucket/policies.hpp`).
  *
  * @note The container is passed **by reference** and must outlive the `bucket`
- * object.
+ * object. Copies refer to the same container; `rebind()` points a bucket at
+ * another container holding the same values (see `owning_bucket` for a
+ * bucket that owns its container).
+ * @note The container does not need to fill the whole view: when
+ * `size() < ROWS * COLS`, the final rows are simply shorter (ragged) and no
+ * element past the end of the container is ever read.
  * @note Values are assumed to be **non-negative**. This is **not enforced for
  * performance reasons**, but is expected when using cumulative sum logic and
  * upper-bound search.
  */
-template <NRAContainer Container> class bucket
+template <NRAContainer Container,
+          typename StoragePolicy = policy::vector_storage,
+          typename RowSearchPolicy = policy::linear_row_search,
+          typename TopSearchPolicy = policy::mirrored_binary_top_search,
+          typename RefreshPolicy = policy::configurable_refresh,
+          typename StatsPolicy = policy::no_stats>
+class bucket
 {
 public:
-  using value_type = typename Container::value_type;
+  using value_type = std::ranges::range_value_t<Container>;
+  /// @brief Container of the row and cumulative sums.
+  using sums_type = typename StoragePolicy::template vector<value_type>;
+  /// @brief The in-row scan, for code that scans rows on the bucket's behalf.
+  using row_search_policy = RowSearchPolicy;
+  /// @brief The search over the cumulative sums.
+  using top_search_policy = TopSearchPolicy;
 
 private:
   mutable std::size_t _min_row_affected, _max_row_affected;
   std::size_t _ROWS;
   std::size_t _COLS;
   std::size_t _size;
-  const Container &_vector;
-  mutable std::vector<value_type> _p_sums;
-  mutable std::vector<value_type> _p_cum_sums;
+  const Container *_vector;
+  mutable sums_type _p_sums;
+  mutable sums_type _p_cum_sums;
+  // Per-row scan order (offsets within the row) for the heavy-first layout.
+  // Empty when the layout is disabled.
+  mutable std::vector<std::uint32_t> _p_order;
+  // Single-precision copy of _p_cum_sums driving the row search. Empty when
+  // the mirror is disabled.
+  mutable typename StoragePolicy::template vector<float> _p_cum_sums_f;
+  // Running rounding-error bound of every DRIFT_BLOCK entries of
+  // _p_cum_sums. Empty when the drift monitor is disabled.
+  mutable std::vector<value_type> _p_drift;
+  value_type _drift_tolerance = static_cast<value_type>(0);
+  mutable std::size_t _drift_resums = 0;
+  // Shadow state of an incremental rebuild: the row sums (and heavy-first
+  // order, when reshaping) of the target shape, built up to _rb_next.
+  // Empty _rb_sums when no rebuild is in progress. Without a reshape,
+  // [_rb_first, _rb_last] spans the shadow rows that differ from _p_sums.
+  sums_type _rb_sums;
+  std::vector<std::uint32_t> _rb_order;
+  std::size_t _rb_rows = 0;
+  std::size_t _rb_cols = 0;
+  std::size_t _rb_step = 1;
+  std::size_t _rb_next = 0;
+  std::size_t _rb_first = 0;
+  std::size_t _rb_last = 0;
+  bool _lazy = RefreshPolicy::lazy;
+  [[no_unique_address]] mutable StatsPolicy _stats;
 
 public:
   /// @brief Sentinel index returned when an upper bound is not found.
   static constexpr std::size_t NOT_FOUND =
       std::numeric_limits<std::size_t>::max();
+  /// @brief Number of elements of `value_type` in a 64-byte SIMD register /
+  /// cache line. Automatically chosen row widths are multiples of it.
+  static constexpr std::size_t SIMD_WIDTH =
+      sizeof(value_type) < 64 ? 64 / sizeof(value_type) : 1;
+  /// @brief Number of cumulative sums sharing one drift bound.
+  static constexpr std::size_t DRIFT_BLOCK = 64;
+  /// @brief Guaranteed alignment (in bytes) of the container's data.
+  static constexpr std::size_t ALIGNMENT = container_alignment_v<Container>;
+  /// @brief Row widths for which fully unrolled row kernels are compiled.
+  static constexpr std::array<std::size_t, 5> KERNEL_WIDTHS = {16, 32, 64,
+                                                               128, 256};
+
   /**
    * @brief Constructs a bucket with a logical ROWS × COLS view over the input
    * container.
@@ -140,25 +322,93 @@ public:
    * @param COLS Number of columns (per row)
    * @param other Reference to the flat container (not copied)
    *
-   * @pre `other.size() <= ROWS * COLS` (an assertion guards this)
+   * @pre `std::ranges::size(other) <= ROWS * COLS` (an assertion guards this)
    * @post Initializes per-row sums and cumulative sums.
    */
   explicit constexpr bucket(ConvertibleToSizeT auto ROWS,
                             ConvertibleToSizeT auto COLS,
                             const Container &other)
-      : _ROWS(ROWS), _COLS(COLS), _vector(other)
+      : _ROWS(ROWS), _COLS(COLS), _vector(&other)
   {
 
     _size = _ROWS * _COLS;
-    assert(other.size() <= ROWS * COLS);
+    assert(std::ranges::size(other) <= _size);
     _p_sums.resize(_ROWS);
     _p_cum_sums.resize(_ROWS + 1);
+    if constexpr (RowSearchPolicy::layout == policy::row_layout::heavy_first)
+      init_row_order();
     update_sum();
     update_cumsum();
     _min_row_affected = _ROWS;
     _max_row_affected = 0;
   }
 
+  /**
+   * @brief Constructs a bucket choosing the shape automatically.
+   *
+   * COLS is taken close to `sqrt(size / 2)` (see the README for the
+   * reasoning) and rounded up to a multiple of `SIMD_WIDTH`. ROWS is the
+   * smallest number of rows covering the container, so only the final row may
+   * be shorter than COLS. Nothing is copied or padded by the caller.
+   *
+   * @param other Reference to the flat container (not copied)
+   */
+  explicit constexpr bucket(const Container &other)
+      : bucket(default_rows(std::ranges::size(other)),
+               default_cols(std::ranges::size(other)), other)
+  {
+  }
+
+  /**
+   * @brief Constructs a bucket from row sums computed elsewhere, e.g. while
+   * the data was being loaded (see `bucket/loader.hpp`), without reading the
+   * container again.
+   *
+   * @param ROWS Number of rows to partition the container
+   * @param COLS Number of columns (per row)
+   * @param other Reference to the flat container (not copied)
+   * @param row_sums The sum of every row, as `update_sum_at_row()` would
+   * compute it
+   *
+   * @pre `row_sums.size() == ROWS` (an assertion guards this)
+   */
+  explicit bucket(ConvertibleToSizeT auto ROWS, ConvertibleToSizeT auto COLS,
+                  const Container &other, std::vector<value_type> row_sums)
+      : _ROWS(ROWS), _COLS(COLS), _vector(&other)
+  {
+    if constexpr (std::is_same_v<sums_type, std::vector<value_type>>)
+      _p_sums = std::move(row_sums);
+    else
+      _p_sums.assign(row_sums.begin(), row_sums.end());
+    _size = _ROWS * _COLS;
+    assert(std::ranges::size(other) <= _size);
+    assert(_p_sums.size() == _ROWS);
+    _p_cum_sums.resize(_ROWS + 1);
+    if constexpr (RowSearchPolicy::layout == policy::row_layout::heavy_first)
+      init_row_order();
+    update_cumsum();
+  }
+
+  /// @brief The number of columns chosen for `size` elements when no shape is
+  /// given: close to `sqrt(size / 2)`, rounded up to a multiple of
+  /// `SIMD_WIDTH`.
+  static constexpr std::size_t default_cols(std::size_t size)
+  {
+    std::size_t target = 1;
+    while (2 * target * target < size)
+      target++;
+    const std::size_t cols = (target + SIMD_WIDTH - 1) / SIMD_WIDTH;
+    return std::max<std::size_t>(cols, 1) * SIMD_WIDTH;
+  }
+
+  /// @brief The number of rows covering `size` elements with `default_cols()`
+  /// columns.
+  static constexpr std::size_t default_rows(std::size_t size)
+  {
+    const std::size_t cols = default_cols(size);
+    return std::max<std::size_t>((size + cols - 1) / cols, 1);
+  }
+
   //------- GETTERS -------//
   /// @brief Returns the total number of elements in the 2D view. ROWS × COLS.
   /// Not to be confused with the size of the underlying container.
@@ -167,6 +417,12 @@ public:
   [[nodiscard]] std::size_t get_rows() const noexcept { return _ROWS; }
   /// @brief Returns the number of columns.
   [[nodiscard]] std::size_t get_cols() const noexcept { return _COLS; }
+  /// @brief Returns the number of elements actually stored in `row`. Equal to
+  /// COLS except for a ragged final row (or rows past the end of the data).
+  [[nodiscard]] std::size_t get_row_length(std::size_t row) const noexcept
+  {
+    return row_length(row, _COLS);
+  }
   /// @brief Returns the index of the first row that was modified since last
   /// refresh.
   [[nodiscard]] std::size_t get_min_row_affected() const noexcept
@@ -179,16 +435,84 @@ public:
   {
     return _max_row_affected;
   }
+  /// @brief Returns the underlying container.
+  [[nodiscard]] const Container &get_container() const noexcept
+  {
+    return *_vector;
+  }
   /// @brief Returns the current per-row sums.
-  [[nodiscard]] const std::vector<value_type> &get_sums() const noexcept
+  [[nodiscard]] const sums_type &get_sums() const noexcept
   {
     return _p_sums;
   }
   /// @brief Returns the current cumulative sums across rows.
-  [[nodiscard]] const std::vector<value_type> &get_cumsums() const noexcept
+  [[nodiscard]] const sums_type &get_cumsums() const noexcept
   {
     return _p_cum_sums;
   }
+  /// @brief Returns the sum of all elements. Kept up to date by
+  /// `update_sum_at_row()` in lazy mode, by the refresh methods otherwise.
+  [[nodiscard]] value_type get_total() const noexcept
+  {
+    return _p_cum_sums.back();
+  }
+  /// @brief Returns whether the cumulative sums are refreshed lazily.
+  [[nodiscard]] constexpr bool is_lazy_refresh() const noexcept
+  {
+    if constexpr (RefreshPolicy::configurable)
+      return _lazy;
+    else
+      return RefreshPolicy::lazy;
+  }
+  /// @brief Returns whether the row search runs on a `float` mirror.
+  [[nodiscard]] constexpr bool is_float_mirror() const noexcept
+  {
+    if constexpr (TopSearchPolicy::float_mirror)
+      return !_p_cum_sums_f.empty();
+    else
+      return false;
+  }
+  /// @brief Returns whether the drift monitor is enabled.
+  [[nodiscard]] bool is_drift_monitor() const noexcept
+  {
+    return !_p_drift.empty();
+  }
+  /// @brief Returns the current bound on the rounding error of cumulative sum
+  /// `i` (0 if the drift monitor is disabled).
+  [[nodiscard]] value_type get_drift_bound(std::size_t i) const noexcept
+  {
+    return is_drift_monitor() ? _p_drift[i / DRIFT_BLOCK]
+                              : static_cast<value_type>(0);
+  }
+  /// @brief Returns how many blocks the drift monitor has re-summed.
+  [[nodiscard]] std::size_t get_drift_resums() const noexcept
+  {
+    return _drift_resums;
+  }
+  /// @brief Returns whether an incremental rebuild is in progress.
+  [[nodiscard]] bool is_rebuilding() const noexcept
+  {
+    return !_rb_sums.empty();
+  }
+  /// @brief Returns whether rows are scanned in descending order of weight.
+  [[nodiscard]] constexpr bool is_heavy_first() const noexcept
+  {
+    if constexpr (RowSearchPolicy::layout == policy::row_layout::configurable)
+      return !_p_order.empty();
+    else
+      return RowSearchPolicy::layout == policy::row_layout::heavy_first;
+  }
+  /// @brief Returns whether the row kernels are instantiated for the current
+  /// row width (one of `KERNEL_WIDTHS`).
+  [[nodiscard]] bool has_fixed_kernels() const noexcept
+  {
+    return std::ranges::find(KERNEL_WIDTHS, _COLS) != KERNEL_WIDTHS.end();
+  }
+  /// @brief Returns the statistics collected by the `StatsPolicy`.
+  [[nodiscard]] const StatsPolicy &get_stats() const noexcept
+  {
+    return _stats;
+  }
   /// @brief Prints the cumulative sums to the standard output.
   void print() const noexcept
   {
@@ -197,13 +521,207 @@ public:
     std::cout << std::endl;
   }
 
+  /**
+   * @brief Points the bucket at `other`, keeping all sums.
+   *
+   * `other` must hold the same values as the current container, e.g. a copy
+   * of it, or the container of an object that was copied or moved along with
+   * this bucket.
+   */
+  void rebind(const Container &other) noexcept { _vector = &other; }
+  void rebind(const Container &&) = delete;
+
+  /**
+   * @brief Enables or disables the heavy-first in-row layout.
+   *
+   * When enabled, the bucket keeps a per-row permutation sorting the elements
+   * of every row by descending weight. `find_upper_bound()` then walks each
+   * row in that order, so most queries stop within the first few elements.
+   * Returned indices still refer to the original container. The permutation
+   * is re-checked in `update_sum_at_row()` and only re-sorted when the order
+   * of that row actually changed.
+   *
+   * @note With the layout enabled, the index returned for a given value
+   * differs from the natural layout (the mapping follows the permuted order),
+   * but it is sampled with the same probability.
+   */
+  void set_heavy_first(bool enable)
+    requires(RowSearchPolicy::layout == policy::row_layout::configurable)
+  {
+    if (!enable)
+    {
+      _p_order.clear();
+      _p_order.shrink_to_fit();
+      return;
+    }
+    if (is_heavy_first())
+      return;
+    init_row_order();
+  }
+
+  /**
+   * @brief Enables or disables the lazy refresh mode.
+   *
+   * In lazy mode `refresh_cumsum()` no longer needs to be called after
+   * updates. Instead, every entry of `_p_cum_sums` up to
+   * `get_min_row_affected()` is known to be valid and `find_upper_bound()`
+   * extends this valid prefix only as far as the row it needs. Refreshes are
+   * thereby coalesced across many updates and few queries, and the
+   * `O(ROWS)` suffix work is only paid when a query actually lands there.
+   * The total (`get_total()`) is kept current on every update.
+   *
+   * Pending work is flushed when switching modes.
+   *
+   * @note In lazy mode the entries of `get_cumsums()` past
+   * `get_min_row_affected()` may be stale until `refresh_cumsum()` is called.
+   */
+  void set_lazy_refresh(bool enable)
+    requires RefreshPolicy::configurable
+  {
+    refresh_cumsum();
+    _lazy = enable;
+  }
+
+  /**
+   * @brief Enables or disables the `float` mirror of the cumulative sums.
+   *
+   * For large ROWS the binary search over `_p_cum_sums` is memory-bound. With
+   * the mirror enabled, the search runs over a `float` copy of it at half the
+   * cache footprint, updated alongside the refreshes. As rounding to `float`
+   * is monotonic, the `float` search narrows the result down to the few rows
+   * whose mirrored values equal the rounded target. An exact comparison on
+   * those candidate rows then settles boundary cases, so results are
+   * identical to the plain search.
+   */
+  void set_float_mirror(bool enable)
+    requires(TopSearchPolicy::float_mirror &&
+             std::is_floating_point_v<value_type> &&
+             sizeof(value_type) > sizeof(float))
+  {
+    if (!enable)
+    {
+      _p_cum_sums_f.clear();
+      _p_cum_sums_f.shrink_to_fit();
+      return;
+    }
+    _p_cum_sums_f.resize(_ROWS + 1);
+    mirror_cumsum(0, _ROWS + 1);
+  }
+
+  /**
+   * @brief Enables the floating-point drift monitor with a tolerance relative
+   * to the total, or disables it with a tolerance of 0.
+   *
+   * `refresh_cumsum()` propagates changes by subtracting differences, so the
+   * rounding errors of `_p_cum_sums` accumulate over time. The monitor keeps a
+   * running error bound per block of `DRIFT_BLOCK` cumulative sums, growing
+   * by the rounding each refresh, lazy extension or delta update can add.
+   * Row sums and re-summations use compensated (Neumaier) accumulation, whose
+   * error does not grow with the number of terms. Row sums need no bound of
+   * their own: `update_sum_at_row()` always re-sums the whole row instead of
+   * applying a difference, so they never drift. Whenever a block's bound
+   * exceeds `tolerance * get_total()`, only that block (and the preceding
+   * ones within half the tolerance, to avoid re-summing it again right away)
+   * is re-summed from the last entry before it. This keeps the accuracy
+   * without periodic full rebuilds.
+   *
+   * @param tolerance Relative tolerance, e.g. `1e-12`; 0 disables the monitor
+   */
+  void set_drift_tolerance(value_type tolerance)
+    requires std::is_floating_point_v<value_type>
+  {
+    _drift_tolerance = tolerance;
+    if (!(tolerance > 0))
+    {
+      _p_drift.clear();
+      _p_drift.shrink_to_fit();
+      return;
+    }
+    refresh_cumsum();
+    _p_drift.assign(_ROWS / DRIFT_BLOCK + 1, static_cast<value_type>(0));
+    update_sum();
+    update_cumsum();
+  }
+
+  /**
+   * @brief Starts an incremental rebuild of all row sums into a shadow copy,
+   * keeping the current shape.
+   *
+   * A full `update_sum()` + `update_cumsum()` costs `O(N)` at once. Instead,
+   * every following `update_sum_at_row()` also computes the next
+   * `rows_per_step` shadow rows, while queries keep being served by the
+   * current sums. Shadow rows already built over the elements an update
+   * changed are recomputed as well, so the shadow stays exact. Once the last
+   * shadow row is built, the shadow sums are swapped in and the cumulative
+   * sums refreshed from the first row whose sum changed, as after an
+   * ordinary update. The worst-case cost of an update therefore stays
+   * bounded. `rebuild_step()`
+   * drives the rebuild explicitly, e.g. from idle time.
+   *
+   * Calling it during a rebuild restarts the rebuild.
+   *
+   * @param rows_per_step Shadow rows computed per update (at least 1)
+   */
+  void begin_rebuild(std::size_t rows_per_step = 1)
+  {
+    begin_rebuild(_ROWS, _COLS, rows_per_step);
+  }
+
+  /**
+   * @brief Starts an incremental rebuild into a new ROWS × COLS shape.
+   *
+   * Same as `begin_rebuild(rows_per_step)`, except that the view switches to
+   * the new shape when the shadow sums are swapped in, which recomputes all
+   * `ROWS + 1` cumulative sums. With the heavy-first
+   * layout, the permutation of the new shape is built alongside. Row indices
+   * passed to `update_sum_at_row()` always refer to the current shape
+   * (`get_rows()` × `get_cols()`).
+   *
+   * @pre `std::ranges::size(container) <= ROWS * COLS`
+   */
+  void begin_rebuild(ConvertibleToSizeT auto ROWS, ConvertibleToSizeT auto COLS,
+                     std::size_t rows_per_step = 1)
+  {
+    _rb_rows = ROWS;
+    _rb_cols = COLS;
+    assert(_rb_rows > 0 && _rb_cols > 0);
+    assert(std::ranges::size(*_vector) <= _rb_rows * _rb_cols);
+    _rb_step = std::max<std::size_t>(rows_per_step, 1);
+    _rb_next = 0;
+    _rb_first = _rb_rows;
+    _rb_last = 0;
+    _rb_sums.assign(_rb_rows, static_cast<value_type>(0));
+    _rb_order.clear();
+    if (is_heavy_first() && (_rb_rows != _ROWS || _rb_cols != _COLS))
+      _rb_order.resize(_rb_rows * _rb_cols);
+  }
+
+  /**
+   * @brief Advances an incremental rebuild by up to `rows` shadow rows and
+   * swaps the shadow sums in once all are built.
+   *
+   * @return Whether no rebuild is in progress anymore
+   */
+  bool rebuild_step(std::size_t rows)
+  {
+    if (!is_rebuilding())
+      return true;
+    const std::size_t last = std::min(_rb_next + rows, _rb_rows);
+    for (; _rb_next < last; _rb_next++)
+      rebuild_row(_rb_next);
+    if (_rb_next < _rb_rows)
+      return false;
+    finish_rebuild();
+    return true;
+  }
+
   /**
    * @brief Updates all per-row sums.
    *
    * Useful when the entire container may have changed.
    * Otherwise, you can use the update_sum_at_row() method for efficiency.
    */
-  void update_sum() const
+  void update_sum()
   {
     for (std::size_t row = 0; row < _ROWS; row++)
       update_sum_at_row(row);
@@ -216,18 +734,37 @@ public:
    * @throws std::runtime_error if row is out of range and ENABLE_CHECKS is
    * defined
    */
-  void update_sum_at_row(std::size_t row) const
+  void update_sum_at_row(std::size_t row)
   {
     ROW_CHECK(row < _ROWS, "Row index out of range");
 
-    auto begin = _vector.begin() + row * _COLS;
-    auto end = begin + _COLS;
-    _p_sums[row] = std::accumulate(begin, end, static_cast<value_type>(0));
+    _stats.on_update();
+    const value_type sum = row_sum(row);
+    if (is_lazy_refresh())
+    {
+      _p_cum_sums[_ROWS] += sum - _p_sums[row];
+      if (is_drift_monitor())
+        _p_drift.back() += 2 * rounding(_p_cum_sums[_ROWS]);
+    }
+    _p_sums[row] = sum;
+    if (is_heavy_first())
+      sort_row_order(row);
 
     if (row < _min_row_affected)
       _min_row_affected = row;
     if (row > _max_row_affected)
       _max_row_affected = row;
+
+    if (is_rebuilding())
+    {
+      // Shadow rows already built over the changed elements are stale.
+      const std::size_t first = row * _COLS / _rb_cols;
+      const std::size_t last =
+          std::min(((row + 1) * _COLS - 1) / _rb_cols + 1, _rb_next);
+      for (std::size_t shadow = first; shadow < last; shadow++)
+        rebuild_row(shadow);
+      rebuild_step(_rb_step);
+    }
   }
 
   /**
@@ -240,10 +777,21 @@ public:
   {
     _p_cum_sums[0] = static_cast<value_type>(0);
 
-    for (std::size_t row = 0; row < _ROWS; row++)
+    if (is_drift_monitor())
     {
-      _p_cum_sums[row + 1] = _p_cum_sums[row] + _p_sums[row];
+      resum_cumsum(0, _ROWS + 1);
+      std::fill(_p_drift.begin(), _p_drift.end(),
+                2 * rounding(_p_cum_sums[_ROWS]));
     }
+    else
+    {
+      for (std::size_t row = 0; row < _ROWS; row++)
+      {
+        _p_cum_sums[row + 1] = _p_cum_sums[row] + _p_sums[row];
+      }
+    }
+    mirror_cumsum(0, _ROWS + 1);
+    _stats.on_refresh(_ROWS);
     _min_row_affected = _ROWS;
     _max_row_affected = 0;
   }
@@ -256,9 +804,25 @@ public:
    *
    * You can update the underlying structure, update the sums at single rows and
    * then call this method, once the updates have been done.
+   *
+   * In lazy mode, this brings the whole pending suffix up to date.
    */
   void refresh_cumsum() const
   {
+    if (_min_row_affected < _ROWS)
+      _stats.on_refresh(_ROWS - _min_row_affected);
+    if (is_lazy_refresh())
+    {
+      for (std::size_t row = _min_row_affected; row < _ROWS; row++)
+        _p_cum_sums[row + 1] = _p_cum_sums[row] + _p_sums[row];
+      mirror_cumsum(_min_row_affected + 1, _ROWS + 1);
+      drift_recomputed(_min_row_affected, _ROWS + 1);
+      _min_row_affected = _ROWS;
+      _max_row_affected = 0;
+      check_drift();
+      return;
+    }
+
     value_type diff = _p_cum_sums[_max_row_affected + 1];
     std::size_t l_row = _min_row_affected;
     for (; l_row < _max_row_affected + 1; l_row++)
@@ -271,8 +835,19 @@ public:
     {
       _p_cum_sums[l_row + 1] -= diff;
     }
+    mirror_cumsum(_min_row_affected + 1, _ROWS + 1);
+    if (_min_row_affected < _ROWS && is_drift_monitor())
+    {
+      drift_recomputed(_min_row_affected, _max_row_affected + 2);
+      // Subtracting the difference rounds both the difference and the entry.
+      const value_type shift = 2 * rounding(_p_cum_sums[_ROWS]);
+      for (std::size_t block = (_max_row_affected + 2) / DRIFT_BLOCK;
+           block < _p_drift.size(); block++)
+        _p_drift[block] += shift;
+    }
     _min_row_affected = _ROWS;
     _max_row_affected = 0;
+    check_drift();
   }
 
   /**
@@ -287,7 +862,8 @@ public:
    * @brief Returns the index in the container where the cumulative sum reaches
    * or exceeds a threshold.
    *
-   * @param val The target value (must be ≥ 0 and less than the total sum)
+   * @param val The target value (must be > 0 and less than the total sum;
+   * for integral types the total itself is also accepted)
    * @return Index into the container, or NOT_FOUND if `val` is out of bounds
    *
    * @throws std::runtime_error if ENABLE_CHECKS is defined and `val` is out of
@@ -298,29 +874,797 @@ public:
     VAL_CHECK(
         val > 0,
         "In upper limit, the value passed is smaller than the first element")
-    VAL_CHECK(val < _p_cum_sums.back(), "In upper limit, the value passed is "
-                                        "bigger or equal to the last element")
+    VAL_CHECK(val < _p_cum_sums.back() ||
+                  (std::is_integral_v<value_type> && val == _p_cum_sums.back()),
+              "In upper limit, the value passed is "
+              "bigger or equal to the last element")
 
-    std::size_t row_index =
-        std::distance(
-            _p_cum_sums.begin(),
-            std::upper_bound(_p_cum_sums.begin(), _p_cum_sums.end(), val)) -
-        1;
+    std::size_t search_end = _ROWS + 1;
+    if (is_lazy_refresh() && _min_row_affected < _ROWS)
+    {
+      if (!detail::reached(val, _p_cum_sums[_min_row_affected]))
+        extend_cumsum(val);
+      search_end = _min_row_affected + 1;
+    }
 
-    std::size_t index = row_index * _COLS;
-    value_type temp = _p_cum_sums[row_index];
+    std::size_t row_index = search_rows(val, search_end);
 
-    auto begin = _vector.begin() + index;
-    auto end = begin + _COLS;
+    if constexpr (RowSearchPolicy::layout != policy::row_layout::natural)
+    {
+      if (is_heavy_first())
+      {
+        const std::size_t index = row_index * _COLS;
+        const std::size_t length = get_row_length(row_index);
+        const value_type *row = data() + index;
+        const std::uint32_t *order = _p_order.data() + index;
+        const std::size_t hit = RowSearchPolicy::scan(
+            row, order, length, _p_cum_sums[row_index], val);
+        _stats.on_query(std::min(hit + 1, length));
+        if (hit < length)
+          return index + order[hit];
+        return row_miss(row_index, val);
+      }
+    }
 
-    for (; begin != end; ++begin, ++index)
+    return scan_row(row_index, val);
+  }
+
+  /**
+   * @brief Cyclic search: returns the first index at or after `start`,
+   * wrapping around at the end, where the running sum of the weights from
+   * `start` reaches `val`.
+   *
+   * Used for round-robin style selection (e.g. lottery or stride
+   * scheduling), where the search resumes from the last selected position.
+   * The rest of the start row is scanned first. The remaining target is then
+   * looked up in `_p_cum_sums` as an absolute value, in the rows after the
+   * start row or, after wrapping around, in the rows before it and the head
+   * of the start row. No prefix sum up to `start` is ever computed.
+   *
+   * Rows are always scanned in their natural order, also with the
+   * heavy-first layout, since the result must be the *first* such index.
+   * In lazy mode pending updates are refreshed first.
+   *
+   * @param start Index into the container to start from
+   * @param val The target value (must be > 0 and at most the total sum)
+   * @return Index into the container, or NOT_FOUND if `val` is not reached
+   * within one cycle (only through rounding)
+   *
+   * @throws std::runtime_error if ENABLE_CHECKS is defined and `start` or
+   * `val` is out of range
+   */
+  [[nodiscard]] std::size_t find_upper_bound_from(std::size_t start,
+                                                  const value_type &val) const
+  {
+    ROW_CHECK(start < std::ranges::size(*_vector), "Start index out of range")
+    VAL_CHECK(val > 0 && val <= get_total(),
+              "In cyclic upper limit, the value passed is out of range")
+
+    if (is_lazy_refresh() && _min_row_affected < _ROWS)
+      refresh_cumsum();
+
+    const std::size_t row = start / _COLS;
+    const std::size_t offset = start - row * _COLS;
+    const std::size_t length = get_row_length(row);
+    const value_type *row_data = data() + row * _COLS;
+
+    // The tail of the start row, with the running sum starting at 0.
+    const std::size_t tail = length - offset;
+    const value_type zero = static_cast<value_type>(0);
+    const std::size_t hit =
+        RowSearchPolicy::scan(row_data + offset, tail, zero, val);
+    if (hit < tail)
+    {
+      _stats.on_query(hit + 1);
+      return start + hit;
+    }
+    const value_type rest =
+        val - std::accumulate(row_data + offset, row_data + length, zero);
+
+    // The rows after the start row, as an absolute target.
+    const value_type total = get_total();
+    const value_type target = _p_cum_sums[row + 1] + rest;
+    if (row + 1 < _ROWS && detail::reached(target, total))
+      return scan_row(search_rows(target, _ROWS + 1), target);
+    if constexpr (std::is_floating_point_v<value_type>)
     {
-      temp += *begin;
-      if (temp >= val)
-        return index;
+      // Exactly the total: the last positive weight after the start row.
+      if (row + 1 < _ROWS && target == total)
+      {
+        const std::size_t end = row * _COLS + length;
+        const std::size_t rest_size = std::ranges::size(*_vector) - end;
+        const std::size_t j = detail::last_positive(data() + end, rest_size);
+        if (j < rest_size)
+          return end + j;
+      }
     }
 
+    // Wrap around: the rows before the start row, then its head.
+    const value_type wrapped = target - total;
+    if (!(wrapped > 0))
+      return NOT_FOUND;
+    const std::size_t wrapped_row = search_rows(wrapped, row + 1);
+    if (wrapped_row < row)
+      return scan_row(wrapped_row, wrapped);
+    const std::size_t head =
+        RowSearchPolicy::scan(row_data, offset, _p_cum_sums[row], wrapped);
+    _stats.on_query(std::min(head + 1, offset));
+    if (head < offset)
+      return row * _COLS + head;
+    if constexpr (std::is_floating_point_v<value_type>)
+    {
+      // Exactly the total (or within rounding of it): the last positive
+      // weight before the start.
+      const std::size_t j = detail::last_positive(data(), start);
+      if (j < start)
+        return j;
+    }
     return NOT_FOUND;
   }
+
+  /**
+   * @brief Draws one index with probability proportional to its weight.
+   *
+   * @param rng A uniform random bit generator (e.g. `std::mt19937`)
+   * @return Index into the container, or NOT_FOUND if the total is not
+   * positive
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] std::size_t sample(URBG &rng) const
+  {
+    const value_type total = get_total();
+    if (!(total > 0))
+      return NOT_FOUND;
+    return find_upper_bound(detail::draw_target(rng, total));
+  }
+
+  /**
+   * @brief Fills `out` with independent samples, as by repeated `sample()`.
+   */
+  template <std::uniform_random_bit_generator URBG>
+  void sample_many(std::span<std::size_t> out, URBG &rng) const
+  {
+    for (std::size_t &index : out)
+      index = sample(rng);
+  }
+
+  /**
+   * @brief Fills `out` with the samples of draws
+   * `[first_draw, first_draw + out.size())` of counter-based stream `stream`.
+   *
+   * Draw `i` is a pure function of `(stream, i)` and the weights (see
+   * `philox4x32`). Splitting the draws of a stream over threads, calls or
+   * batch sizes in any way therefore gives bit-identical results. The
+   * uniforms are generated in vectorizable batches ahead of the lookups.
+   *
+   * @note Concurrent calls on a shared bucket only read it, provided no
+   * refresh is pending (call `refresh_cumsum()` first in lazy mode).
+   */
+  void sample_many(std::span<std::size_t> out, std::uint64_t stream,
+                   std::uint64_t first_draw) const
+  {
+    using unit_type =
+        std::conditional_t<std::is_floating_point_v<value_type>, value_type,
+                           double>;
+    constexpr std::size_t BATCH = 64;
+    std::array<unit_type, BATCH> units;
+
+    const value_type total = get_total();
+    for (std::size_t j = 0; j < out.size(); j += BATCH)
+    {
+      const std::size_t count = std::min(BATCH, out.size() - j);
+      if (!(total > 0))
+      {
+        std::fill_n(out.begin() + j, count, NOT_FOUND);
+        continue;
+      }
+      philox4x32::fill_uniform(stream, first_draw + j,
+                               std::span<unit_type>(units.data(), count));
+      for (std::size_t k = 0; k < count; k++)
+        out[j + k] = find_upper_bound(scale_unit(units[k], total));
+    }
+  }
+
+  /**
+   * @brief Draws `k` indices with replacement and returns how many times each
+   * index was drawn (a multinomial draw over the weights).
+   *
+   * Instead of `k` independent searches, `k` is split across the rows with
+   * conditional binomial draws along the row sums, then across the elements
+   * of each row that received at least one sample. The cost is
+   * `O(ROWS + min(k, ROWS) * COLS)` instead of `O(k * (log(ROWS) + COLS))`.
+   *
+   * @param k Number of samples
+   * @param rng A uniform random bit generator (e.g. `std::mt19937`)
+   * @return A vector with one count per element of the container, summing to
+   * `k` (all zeros if the total is not positive)
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] std::vector<std::size_t> sample_counts(std::size_t k,
+                                                       URBG &rng) const
+  {
+    std::vector<std::size_t> counts(std::ranges::size(*_vector), 0);
+    if (!(get_total() > 0))
+      return counts;
+
+    split_samples(k, _p_sums.data(), _ROWS, get_total(), rng,
+                  [&](std::size_t row, std::size_t row_k)
+                  {
+                    const std::size_t base = row * _COLS;
+                    split_samples(row_k, data() + base, get_row_length(row),
+                                  _p_sums[row], rng,
+                                  [&](std::size_t col, std::size_t col_k)
+                                  { counts[base + col] = col_k; });
+                  });
+    return counts;
+  }
+
+  /**
+   * @brief Draws `k` indices with replacement, like `sample_counts()`, and
+   * returns them as a sorted list.
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] std::vector<std::size_t> sample_indices(std::size_t k,
+                                                        URBG &rng) const
+  {
+    const std::vector<std::size_t> counts = sample_counts(k, rng);
+    std::vector<std::size_t> indices;
+    indices.reserve(k);
+    for (std::size_t i = 0; i < counts.size(); i++)
+      indices.insert(indices.end(), counts[i], i);
+    return indices;
+  }
+
+private:
+  /**
+   * @brief Maps a uniform `unit` in (0, 1) to a valid search value for
+   * `find_upper_bound()` over a positive `total`.
+   */
+  template <typename Unit>
+  static value_type scale_unit(Unit unit, value_type total) noexcept
+  {
+    if constexpr (std::is_integral_v<value_type>)
+    {
+      const auto val =
+          1 + static_cast<value_type>(std::floor(unit * static_cast<Unit>(total)));
+      return std::min(val, total);
+    }
+    else
+    {
+      const value_type val = unit * total;
+      return val < total ? val : std::nextafter(total, value_type{0});
+    }
+  }
+
+  /**
+   * @brief Splits `k` samples over `length` weights of total `mass` with
+   * conditional binomial draws, calling `emit(i, k_i)` for every `k_i > 0`.
+   *
+   * The last positive weight receives whatever is left, so rounding in `mass`
+   * can neither lose samples nor assign any to a zero weight.
+   */
+  template <typename URBG, typename Emit>
+  static void split_samples(std::size_t k, const value_type *weights,
+                            std::size_t length, value_type mass, URBG &rng,
+                            Emit &&emit)
+  {
+    std::size_t last = length;
+    while (last > 0 && !(weights[last - 1] > 0))
+      last--;
+    if (last == 0)
+      return;
+
+    double remaining = static_cast<double>(mass);
+    for (std::size_t i = 0; i < last - 1 && k > 0; i++)
+    {
+      if (!(weights[i] > 0))
+        continue;
+      const double weight = static_cast<double>(weights[i]);
+      std::size_t drawn = k;
+      if (weight < remaining)
+      {
+        std::binomial_distribution<std::size_t> dist(k, weight / remaining);
+        drawn = dist(rng);
+      }
+      remaining -= weight;
+      if (drawn > 0)
+      {
+        emit(i, drawn);
+        k -= drawn;
+      }
+    }
+    if (k > 0)
+      emit(last - 1, k);
+  }
+
+  const value_type *data() const noexcept
+  {
+    return std::ranges::data(*_vector);
+  }
+
+  /**
+   * @brief Sums the elements of a row.
+   *
+   * When every row starts on an `ALIGNMENT` boundary, the compiler is told so,
+   * letting it use aligned vector loads without a peeling prologue.
+   */
+  value_type row_sum(std::size_t row) const { return row_sum(row, _COLS); }
+
+  /// @brief Sums the elements of a row of a view with `cols` columns.
+  value_type row_sum(std::size_t row, std::size_t cols) const
+  {
+    if (cols != _COLS)
+      return row_sum_impl<0>(row, cols);
+    return dispatch_width([&](auto width)
+                          { return row_sum_impl<width()>(row, cols); });
+  }
+
+  /// @brief `row_sum()` with full rows of `WIDTH` elements summed by the
+  /// fixed-width kernel (none if `WIDTH` is 0).
+  template <std::size_t WIDTH>
+  value_type row_sum_impl(std::size_t row, std::size_t cols) const
+  {
+    const value_type *begin = data() + row * cols;
+    const value_type *end = begin + row_length(row, cols);
+    if (is_drift_monitor())
+    {
+      value_type sum = static_cast<value_type>(0);
+      value_type compensation = static_cast<value_type>(0);
+      for (; begin != end; ++begin)
+      {
+        const value_type next = sum + *begin;
+        if (std::abs(sum) >= std::abs(*begin))
+          compensation += (sum - next) + *begin;
+        else
+          compensation += (*begin - next) + sum;
+        sum = next;
+      }
+      return sum + compensation;
+    }
+    if constexpr (WIDTH != 0)
+    {
+      if (static_cast<std::size_t>(end - begin) == WIDTH)
+        return fixed_row_sum<WIDTH>(begin);
+    }
+    if constexpr (ALIGNMENT > alignof(value_type))
+    {
+      if ((cols * sizeof(value_type)) % ALIGNMENT == 0)
+      {
+        const value_type *aligned = std::assume_aligned<ALIGNMENT>(begin);
+        return std::accumulate(aligned, aligned + (end - begin),
+                               static_cast<value_type>(0));
+      }
+    }
+    return std::accumulate(begin, end, static_cast<value_type>(0));
+  }
+
+  /**
+   * @brief Returns the row containing `val`, searching the cumulative sums
+   * `[1, end)`.
+   *
+   * With the `float` mirror, one search over the mirror finds the first entry
+   * whose rounded value exceeds the rounded target. Monotonic rounding
+   * guarantees that the exact answer lies between the first mirrored entry
+   * equal to the rounded target and that entry, so the exact comparison only
+   * needs to look at those few candidates.
+   */
+  std::size_t search_rows(const value_type &val, std::size_t end) const
+  {
+    auto first = _p_cum_sums.begin() + 1;
+    auto last = _p_cum_sums.begin() + end;
+
+    if (is_float_mirror())
+    {
+      const float key = static_cast<float>(val);
+      const auto mirror = _p_cum_sums_f.begin();
+      auto hi = std::upper_bound(mirror + 1, mirror + end, key);
+      auto lo = hi;
+      if (lo != mirror + 1 && *(lo - 1) == key)
+        lo = std::lower_bound(mirror + 1, hi, key);
+      first = _p_cum_sums.begin() + (lo - mirror);
+      last = _p_cum_sums.begin() + (hi - mirror);
+    }
+
+    auto it = TopSearchPolicy::find(first, last, val,
+                                    detail::reached<value_type>);
+    return static_cast<std::size_t>(std::distance(_p_cum_sums.begin(), it)) -
+           1;
+  }
+
+  /// @brief Scans a row in its natural order for the element where the
+  /// cumulative sum reaches `val`.
+  std::size_t scan_row(std::size_t row_index, const value_type &val) const
+  {
+    return dispatch_width([&](auto width)
+                          { return scan_row_impl<width()>(row_index, val); });
+  }
+
+  /// @brief `scan_row()` with full rows of `WIDTH` elements scanned with the
+  /// width known at compile time (never if `WIDTH` is 0).
+  template <std::size_t WIDTH>
+  std::size_t scan_row_impl(std::size_t row_index,
+                            const value_type &val) const
+  {
+    const std::size_t index = row_index * _COLS;
+    const std::size_t length = get_row_length(row_index);
+    const value_type *row = data() + index;
+    const value_type sum = _p_cum_sums[row_index];
+    std::size_t hit;
+    if constexpr (WIDTH != 0)
+      hit = length == WIDTH ? RowSearchPolicy::scan(row, WIDTH, sum, val)
+                            : RowSearchPolicy::scan(row, length, sum, val);
+    else
+      hit = RowSearchPolicy::scan(row, length, sum, val);
+    _stats.on_query(std::min(hit + 1, length));
+    return hit < length ? index + hit : row_miss(row_index, val);
+  }
+
+  /**
+   * @brief Resolves a scan of `row_index` that did not reach `val`.
+   *
+   * If the cumulative sum at the end of the row reaches `val`, the running
+   * sum of the scan (or the block sums of `blocked_row_search`) only rounded
+   * below it, and the target lies at the end of the row: its last positive
+   * element. Otherwise `val` is out of range.
+   */
+  std::size_t row_miss(std::size_t row_index, const value_type &val) const
+  {
+    if (row_index >= _ROWS || !detail::reached(val, _p_cum_sums[row_index + 1]))
+      return NOT_FOUND;
+    const std::size_t index = row_index * _COLS;
+    const std::size_t length = get_row_length(row_index);
+    const std::size_t last = detail::last_positive(data() + index, length);
+    return last < length ? index + last : NOT_FOUND;
+  }
+
+  /// @brief Copies the cumulative sums `[first, last)` into the mirror.
+  void mirror_cumsum(std::size_t first, std::size_t last) const
+  {
+    if (!is_float_mirror())
+      return;
+    for (std::size_t i = first; i < last; i++)
+      _p_cum_sums_f[i] = static_cast<float>(_p_cum_sums[i]);
+  }
+
+  /**
+   * @brief Recomputes the stale cumulative sums of lazy mode, starting at the
+   * first affected row, until one exceeds `val` (or up to the end).
+   *
+   * The valid prefix then ends at that entry. Every stale entry is recomputed
+   * from its predecessor, since the deferred differences of previous updates
+   * were never propagated.
+   */
+  void extend_cumsum(const value_type &val) const
+  {
+    std::size_t row = _min_row_affected;
+    for (; row < _ROWS; row++)
+    {
+      _p_cum_sums[row + 1] = _p_cum_sums[row] + _p_sums[row];
+      if (detail::reached(val, _p_cum_sums[row + 1]))
+        break;
+    }
+    mirror_cumsum(_min_row_affected + 1, std::min(row + 2, _ROWS + 1));
+    drift_recomputed(_min_row_affected, std::min(row + 2, _ROWS + 1));
+    _stats.on_refresh(std::min(row + 1, _ROWS) - _min_row_affected);
+
+    if (row < _ROWS - 1)
+      _min_row_affected = row + 1;
+    else
+    {
+      _min_row_affected = _ROWS;
+      _max_row_affected = 0;
+    }
+    check_drift();
+  }
+
+  /// @brief Unit rounding error of an operation producing `value`.
+  static value_type rounding(const value_type &value) noexcept
+  {
+    if constexpr (std::is_floating_point_v<value_type>)
+      return std::numeric_limits<value_type>::epsilon() * std::abs(value);
+    else
+      return static_cast<value_type>(0);
+  }
+
+  /**
+   * @brief Recomputes the cumulative sums `(base, last)` from entry `base`
+   * with compensated (Neumaier) summation.
+   */
+  void resum_cumsum(std::size_t base, std::size_t last) const
+  {
+    value_type sum = _p_cum_sums[base];
+    value_type compensation = static_cast<value_type>(0);
+    for (std::size_t i = base + 1; i < last; i++)
+    {
+      const value_type term = _p_sums[i - 1];
+      const value_type next = sum + term;
+      if (std::abs(sum) >= std::abs(term))
+        compensation += (sum - next) + term;
+      else
+        compensation += (term - next) + sum;
+      sum = next;
+      _p_cum_sums[i] = sum + compensation;
+    }
+  }
+
+  /**
+   * @brief Updates the drift bounds of the cumulative sums `(base, last)`,
+   * just recomputed by plain additions from entry `base`.
+   */
+  void drift_recomputed(std::size_t base, std::size_t last) const
+  {
+    if (!is_drift_monitor() || base + 1 >= last)
+      return;
+    const value_type bound = get_drift_bound(base) +
+                             static_cast<value_type>(last - base - 1) *
+                                 rounding(_p_cum_sums[last - 1]);
+    const std::size_t first_block = (base + 1) / DRIFT_BLOCK;
+    const std::size_t last_block = (last - 1) / DRIFT_BLOCK;
+    for (std::size_t block = first_block; block <= last_block; block++)
+    {
+      // Partially covered blocks keep the bound of their other entries.
+      const bool full = block * DRIFT_BLOCK >= base + 1 &&
+                        (block + 1) * DRIFT_BLOCK <= last;
+      _p_drift[block] = full ? bound : std::max(_p_drift[block], bound);
+    }
+  }
+
+  /**
+   * @brief Re-sums the valid blocks of cumulative sums whose drift bound
+   * exceeds the tolerance.
+   */
+  void check_drift() const
+  {
+    if (!is_drift_monitor())
+      return;
+    const value_type limit = _drift_tolerance * std::abs(get_total());
+    // In lazy mode only the valid prefix is worth re-summing.
+    const std::size_t valid =
+        _min_row_affected < _ROWS ? _min_row_affected + 1 : _ROWS + 1;
+
+    for (std::size_t block = 0; block * DRIFT_BLOCK < valid; block++)
+    {
+      if (!(_p_drift[block] > limit))
+        continue;
+
+      std::size_t first = block;
+      while (first > 0 && _p_drift[first - 1] > limit / 2)
+        first--;
+      for (std::size_t b = first; b <= block; b++)
+      {
+        const std::size_t base = b == 0 ? 0 : b * DRIFT_BLOCK - 1;
+        const std::size_t last = std::min((b + 1) * DRIFT_BLOCK, valid);
+        resum_cumsum(base, last);
+        mirror_cumsum(base + 1, last);
+        _p_drift[b] = (b == 0 ? static_cast<value_type>(0) : _p_drift[b - 1]) +
+                      2 * rounding(_p_cum_sums[last - 1]);
+        _drift_resums++;
+      }
+    }
+  }
+
+  /**
+   * @brief Restores the descending-weight order of a row's permutation.
+   *
+   * A single pass detects whether the order is still valid. Otherwise an
+   * insertion sort is used, which is linear for the common case of one or two
+   * elements having moved since the last call.
+   */
+  void sort_row_order(std::size_t row) const
+  {
+    sort_order(_p_order.data() + row * _COLS, row * _COLS,
+               get_row_length(row));
+  }
+
+  /// @brief Sorts the offsets `order[0, length)` of the elements starting at
+  /// `base` by descending weight.
+  void sort_order(std::uint32_t *order, std::size_t base,
+                  std::size_t length) const
+  {
+    auto heavier = [&](std::uint32_t a, std::uint32_t b)
+    { return data()[base + a] > data()[base + b]; };
+
+    if (std::is_sorted(order, order + length, heavier))
+      return;
+
+    for (std::size_t i = 1; i < length; i++)
+    {
+      std::uint32_t key = order[i];
+      std::size_t j = i;
+      for (; j > 0 && heavier(key, order[j - 1]); j--)
+        order[j] = order[j - 1];
+      order[j] = key;
+    }
+  }
+
+  /// @brief Sums a full row of `WIDTH` elements. With the width known at
+  /// compile time the loop is fully unrolled, with no remainder handling, and
+  /// the alignment of every row is known as well.
+  template <std::size_t WIDTH>
+  static value_type fixed_row_sum(const value_type *row) noexcept
+  {
+    if constexpr (ALIGNMENT > alignof(value_type) &&
+                  (WIDTH * sizeof(value_type)) % ALIGNMENT == 0)
+      row = std::assume_aligned<ALIGNMENT>(row);
+    value_type sum = static_cast<value_type>(0);
+    for (std::size_t i = 0; i < WIDTH; i++)
+      sum += row[i];
+    return sum;
+  }
+
+  /**
+   * @brief Calls `f` with the row width as a `std::integral_constant` if
+   * `_COLS` is one of `KERNEL_WIDTHS`, or with 0 otherwise.
+   *
+   * The switch is a direct, well-predicted branch, and `f` is instantiated
+   * for every width, so the fixed-width loops inline into the caller. A
+   * narrower row cannot use a wider kernel, since the container is not padded
+   * and the kernel would read the next row.
+   */
+  template <typename F> decltype(auto) dispatch_width(F &&f) const
+  {
+    static_assert(KERNEL_WIDTHS.size() == 5, "One case per kernel width");
+    switch (_COLS)
+    {
+    case KERNEL_WIDTHS[0]:
+      return f(std::integral_constant<std::size_t, KERNEL_WIDTHS[0]>{});
+    case KERNEL_WIDTHS[1]:
+      return f(std::integral_constant<std::size_t, KERNEL_WIDTHS[1]>{});
+    case KERNEL_WIDTHS[2]:
+      return f(std::integral_constant<std::size_t, KERNEL_WIDTHS[2]>{});
+    case KERNEL_WIDTHS[3]:
+      return f(std::integral_constant<std::size_t, KERNEL_WIDTHS[3]>{});
+    case KERNEL_WIDTHS[4]:
+      return f(std::integral_constant<std::size_t, KERNEL_WIDTHS[4]>{});
+    default:
+      return f(std::integral_constant<std::size_t, 0>{});
+    }
+  }
+
+  /// @brief Builds the heavy-first permutation of every row.
+  void init_row_order() const
+  {
+    _p_order.resize(_ROWS * _COLS);
+    for (std::size_t row = 0; row < _ROWS; row++)
+      init_order(_p_order.data() + row * _COLS, row * _COLS,
+                 get_row_length(row));
+  }
+
+  /// @brief Initializes and sorts the offsets of the elements starting at
+  /// `base`.
+  void init_order(std::uint32_t *order, std::size_t base,
+                  std::size_t length) const
+  {
+    std::iota(order, order + length, std::uint32_t{0});
+    sort_order(order, base, length);
+  }
+
+  /// @brief Number of elements of `row` in a view with `cols` columns.
+  std::size_t row_length(std::size_t row, std::size_t cols) const noexcept
+  {
+    const std::size_t begin = row * cols;
+    const std::size_t size = std::ranges::size(*_vector);
+    return begin < size ? std::min(cols, size - begin) : 0;
+  }
+
+  /// @brief Computes one shadow row of an incremental rebuild.
+  void rebuild_row(std::size_t row)
+  {
+    _rb_sums[row] = row_sum(row, _rb_cols);
+    if (_rb_rows == _ROWS && _rb_cols == _COLS &&
+        _rb_sums[row] != _p_sums[row])
+    {
+      _rb_first = std::min(_rb_first, row);
+      _rb_last = std::max(_rb_last, row);
+    }
+    if (!_rb_order.empty())
+      init_order(_rb_order.data() + row * _rb_cols, row * _rb_cols,
+                 row_length(row, _rb_cols));
+  }
+
+  /// @brief Swaps the shadow sums of a completed rebuild in. Without a
+  /// reshape, only the cumulative sums from the first changed row on are
+  /// refreshed; a reshape recomputes them all.
+  void finish_rebuild()
+  {
+    _p_sums.swap(_rb_sums);
+    const bool reshape = _rb_rows != _ROWS || _rb_cols != _COLS;
+    if (reshape)
+    {
+      _ROWS = _rb_rows;
+      _COLS = _rb_cols;
+      _size = _ROWS * _COLS;
+      _p_cum_sums.resize(_ROWS + 1);
+      if (is_float_mirror())
+        _p_cum_sums_f.resize(_ROWS + 1);
+      if (is_drift_monitor())
+        _p_drift.resize(_ROWS / DRIFT_BLOCK + 1);
+      if (is_heavy_first())
+      {
+        // Heavy-first was enabled mid-rebuild: build the order at once.
+        if (_rb_order.size() != _size)
+        {
+          _rb_order.resize(_size);
+          for (std::size_t row = 0; row < _ROWS; row++)
+            init_order(_rb_order.data() + row * _COLS, row * _COLS,
+                       get_row_length(row));
+        }
+        _p_order.swap(_rb_order);
+      }
+    }
+    _rb_sums.clear();
+    _rb_sums.shrink_to_fit();
+    _rb_order.clear();
+    _rb_order.shrink_to_fit();
+    if (reshape)
+    {
+      update_cumsum();
+      return;
+    }
+    if (_rb_first > _rb_last)
+      return;
+    _min_row_affected = std::min(_min_row_affected, _rb_first);
+    _max_row_affected = std::max(_max_row_affected, _rb_last);
+    refresh_cumsum();
+  }
+};
+
+/**
+ * @brief A `bucket` together with the container it refers to.
+ *
+ * Copies and moves rebind the bucket to the container of the new object, so
+ * classes that own their weights keep normal value semantics.
+ */
+template <NRAContainer Container, typename... Policies> class owning_bucket
+{
+  Container _values;
+  bucket<Container, Policies...> _bucket;
+
+public:
+  /// @brief Takes ownership of `values` and builds a bucket of the default
+  /// shape over them.
+  explicit owning_bucket(Container values)
+      : _values(std::move(values)), _bucket(_values)
+  {
+  }
+
+  owning_bucket(const owning_bucket &other)
+      : _values(other._values), _bucket(other._bucket)
+  {
+    _bucket.rebind(_values);
+  }
+  owning_bucket(owning_bucket &&other) noexcept
+      : _values(std::move(other._values)), _bucket(std::move(other._bucket))
+  {
+    _bucket.rebind(_values);
+  }
+  owning_bucket &operator=(const owning_bucket &other)
+  {
+    _values = other._values;
+    _bucket = other._bucket;
+    _bucket.rebind(_values);
+    return *this;
+  }
+  owning_bucket &operator=(owning_bucket &&other) noexcept
+  {
+    _values = std::move(other._values);
+    _bucket = std::move(other._bucket);
+    _bucket.rebind(_values);
+    return *this;
+  }
+
+  /// @brief Returns the owned values. Changes must be followed by
+  /// `update_sum_at_row()` on the bucket, as for any container.
+  [[nodiscard]] Container &values() noexcept { return _values; }
+  [[nodiscard]] const Container &values() const noexcept { return _values; }
+  /// @brief Returns the bucket over the owned values.
+  [[nodiscard]] bucket<Container, Policies...> &get() noexcept
+  {
+    return _bucket;
+  }
+  [[nodiscard]] const bucket<Container, Policies...> &get() const noexcept
+  {
+    return _bucket;
+  }
 };
 }; // namespace bucketlib
\ No newline at end of file
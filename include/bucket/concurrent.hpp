@@ -0,0 +1,273 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace bucketlib
+{
+
+/**
+ * @brief An approximate sampler over weights written and sampled by many
+ * threads at once, without locks and without a global refresh.
+ *
+ * The weights stay in the caller's storage and are only accessed through
+ * `std::atomic_ref`. They are split into rows of `COLS` weights, and the rows
+ * into blocks of about `sqrt(ROWS)` rows. Every row and every block keeps its
+ * sum in a relaxed atomic that writers update by the delta of their change:
+ * ```
+ *   set(i, w):  old = exchange(weight[i], w)
+ *               row_sum[row(i)]     += w - old
+ *               block_sum[block(i)] += w - old
+ * ```
+ * There are no cumulative sums to refresh. A lookup scans the block sums,
+ * then the row sums of its block, then its row. Writes to different blocks
+ * touch different cache lines (block sums are padded), so writers only
+ * contend when they hit the same block at the same time.
+ *
+ * Guarantees are deliberately weak:
+ *  - Every lookup returns an index whose weight was positive when read (or
+ *    NOT_FOUND if no positive weight was seen in the block the sums led
+ *    to), never an out-of-range index. Stale sums are resolved within that
+ *    block, so a lookup never scans more than one block of weights.
+ *  - Staleness is bounded by the writes in flight during the lookup. Every
+ *    sum is changed only by atomic read-modify-writes, so no delta is lost
+ *    and errors do not accumulate. By the coherence of each atomic, a sum
+ *    read by a lookup includes every `set()`/`add()` that happens before
+ *    the lookup (e.g. made before a thread join, or ordered by a lock) and
+ *    none that happens after it. Each sum read therefore differs from the
+ *    exact sum by at most the deltas of the writes that overlap the
+ *    lookup. Sampling is exact in quiescent periods.
+ *  - The sums are relaxed atomics: the three levels are not ordered
+ *    against each other, so a lookup may see a write in a block sum but
+ *    not yet in its row sum. This is within the bound above.
+ *  - With floating-point weights, the delta updates accumulate rounding in
+ *    the sums. `rebuild()` re-sums them exactly while no thread writes.
+ *
+ * @tparam T Arithmetic weight type supported by `std::atomic_ref`
+ *
+ * @note All writes to the weights must go through `set()` or `add()`, and
+ * the weights must outlive the sampler.
+ */
+template <Numeric T> class concurrent_bucket
+{
+public:
+  using value_type = T;
+
+  /// @brief Sentinel index returned when no positive weight is found.
+  static constexpr std::size_t NOT_FOUND =
+      std::numeric_limits<std::size_t>::max();
+
+private:
+  // One block sum per cache line, so writers to different blocks do not
+  // share lines.
+  struct alignas(64) padded_sum
+  {
+    std::atomic<T> value{};
+  };
+
+  std::span<T> _weights;
+  std::size_t _COLS;
+  std::size_t _ROWS;
+  std::size_t _BLOCK;
+  std::vector<std::atomic<T>> _row_sums;
+  std::vector<padded_sum> _block_sums;
+
+public:
+  /**
+   * @brief Constructs the sampler over `weights`.
+   *
+   * @param weights The weights (not copied), suitably aligned for
+   * `std::atomic_ref`
+   * @param cols Weights per row, or 0 for `bucket::default_cols()`
+   */
+  explicit concurrent_bucket(std::span<T> weights, std::size_t cols = 0)
+      : _weights(weights),
+        _COLS(cols > 0 ? cols
+                       : bucket<std::vector<T>>::default_cols(weights.size())),
+        _ROWS(std::max<std::size_t>((weights.size() + _COLS - 1) / _COLS, 1)),
+        _BLOCK(block_rows(_ROWS)), _row_sums(_ROWS),
+        _block_sums((_ROWS + _BLOCK - 1) / _BLOCK)
+  {
+    assert(reinterpret_cast<std::uintptr_t>(weights.data()) %
+               std::atomic_ref<T>::required_alignment ==
+           0);
+    rebuild();
+  }
+
+  concurrent_bucket(const concurrent_bucket &) = delete;
+  concurrent_bucket &operator=(const concurrent_bucket &) = delete;
+
+  //------- GETTERS -------//
+  /// @brief Returns the number of weights.
+  [[nodiscard]] std::size_t size() const noexcept { return _weights.size(); }
+  /// @brief Returns the number of rows.
+  [[nodiscard]] std::size_t get_rows() const noexcept { return _ROWS; }
+  /// @brief Returns the number of columns.
+  [[nodiscard]] std::size_t get_cols() const noexcept { return _COLS; }
+  /// @brief Returns the current weight of index `i`.
+  [[nodiscard]] T get(std::size_t i) const noexcept
+  {
+    return std::atomic_ref<T>(_weights[i]).load(std::memory_order_relaxed);
+  }
+  /// @brief Returns the sum of all weights, up to in-flight writes.
+  [[nodiscard]] T get_total() const noexcept
+  {
+    T total = static_cast<T>(0);
+    for (const padded_sum &block : _block_sums)
+      total += block.value.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  /// @brief Sets the weight of index `i`. Lock-free, callable from any
+  /// thread.
+  void set(std::size_t i, T weight) noexcept
+  {
+    const T old = std::atomic_ref<T>(_weights[i]).exchange(
+        weight, std::memory_order_relaxed);
+    propagate(i, weight - old);
+  }
+
+  /// @brief Adds `delta` to the weight of index `i`. Lock-free, callable
+  /// from any thread.
+  void add(std::size_t i, T delta) noexcept
+  {
+    std::atomic_ref<T>(_weights[i]).fetch_add(delta,
+                                               std::memory_order_relaxed);
+    propagate(i, delta);
+  }
+
+  /**
+   * @brief Returns an index where the running sum of the weights reaches
+   * `val`, as seen by this thread while others may write.
+   *
+   * @param val The target value, in (0, get_total()]
+   * @return Index of a weight read as positive, or NOT_FOUND
+   */
+  [[nodiscard]] std::size_t find_upper_bound(T val) const noexcept
+  {
+    std::size_t block = 0;
+    for (; block + 1 < _block_sums.size(); block++)
+    {
+      const T sum = _block_sums[block].value.load(std::memory_order_relaxed);
+      if (detail::reached(val, sum))
+        break;
+      val -= sum;
+    }
+
+    std::size_t row = block * _BLOCK;
+    const std::size_t last_row = std::min(row + _BLOCK, _ROWS);
+    for (; row + 1 < last_row; row++)
+    {
+      const T sum = _row_sums[row].load(std::memory_order_relaxed);
+      if (detail::reached(val, sum))
+        break;
+      val -= sum;
+    }
+
+    const std::size_t first = row * _COLS;
+    const std::size_t last = std::min(first + _COLS, _weights.size());
+    T running = static_cast<T>(0);
+    std::size_t positive = NOT_FOUND;
+    for (std::size_t i = first; i < last; i++)
+    {
+      const T weight = get(i);
+      if (!(weight > 0))
+        continue;
+      running += weight;
+      positive = i;
+      if (running >= val)
+        return i;
+    }
+    // The sums were stale: fall back to a positive weight nearby.
+    return positive != NOT_FOUND ? positive : any_positive(block, last);
+  }
+
+  /**
+   * @brief Draws one index with probability proportional to its weight (up
+   * to in-flight writes).
+   *
+   * Thread-safe with one generator per thread.
+   *
+   * @return Index, or NOT_FOUND if no positive weight is found
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] std::size_t sample(URBG &rng) const
+  {
+    const T total = get_total();
+    if (!(total > 0))
+      return NOT_FOUND;
+
+    return find_upper_bound(detail::draw_target(rng, total));
+  }
+
+  /**
+   * @brief Re-sums all row and block sums from the weights.
+   *
+   * Drops the rounding accumulated by floating-point deltas. Must not run
+   * concurrently with writers.
+   */
+  void rebuild() noexcept
+  {
+    for (std::size_t row = 0; row < _ROWS; row++)
+    {
+      T sum = static_cast<T>(0);
+      const std::size_t last = std::min((row + 1) * _COLS, _weights.size());
+      for (std::size_t i = row * _COLS; i < last; i++)
+        sum += get(i);
+      _row_sums[row].store(sum, std::memory_order_relaxed);
+    }
+    for (std::size_t block = 0; block < _block_sums.size(); block++)
+    {
+      T sum = static_cast<T>(0);
+      const std::size_t last = std::min((block + 1) * _BLOCK, _ROWS);
+      for (std::size_t row = block * _BLOCK; row < last; row++)
+        sum += _row_sums[row].load(std::memory_order_relaxed);
+      _block_sums[block].value.store(sum, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static std::size_t block_rows(std::size_t rows) noexcept
+  {
+    std::size_t block = 1;
+    while (block * block < rows)
+      block++;
+    return block;
+  }
+
+  void propagate(std::size_t i, T delta) noexcept
+  {
+    if (delta == static_cast<T>(0))
+      return;
+    const std::size_t row = i / _COLS;
+    _row_sums[row].fetch_add(delta, std::memory_order_relaxed);
+    _block_sums[row / _BLOCK].value.fetch_add(delta,
+                                              std::memory_order_relaxed);
+  }
+
+  // First positive weight of `block` at or after `from`, wrapping around
+  // within the block.
+  std::size_t any_positive(std::size_t block, std::size_t from) const noexcept
+  {
+    const std::size_t first = block * _BLOCK * _COLS;
+    const std::size_t last =
+        std::min((block + 1) * _BLOCK * _COLS, _weights.size());
+    const std::size_t n = last - first;
+    for (std::size_t k = 0; k < n; k++)
+    {
+      const std::size_t i = first + (from - first + k) % n;
+      if (get(i) > 0)
+        return i;
+    }
+    return NOT_FOUND;
+  }
+};
+} // namespace bucketlib
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace bucketlib
+{
+
+/**
+ * @brief A calendar queue of timed events with a fixed capacity. After
+ * construction, it never allocates.
+ *
+ * Time is split into days of `width`. Day `d` is stored in slot
+ * `d % days`, and each slot holds a list of events sorted by time. All events
+ * live in a node pool that is allocated once, and free nodes are linked into
+ * a free list. A push inserts into one short list. A pop finds the next
+ * minimum, continuing from the day of the one it removed. If no slot holds an event of its current day
+ * for a whole year of days, the pop falls back to a direct search over the
+ * slot heads.
+ *
+ * With `width` around the typical spacing of consecutive events, push and
+ * pop take expected O(1).
+ *
+ * @note Events with equal times are popped in push order.
+ */
+class calendar_queue
+{
+public:
+  using id_type = std::uint32_t;
+
+private:
+  static constexpr std::uint32_t NIL =
+      std::numeric_limits<std::uint32_t>::max();
+
+  struct node
+  {
+    double time;
+    id_type id;
+    std::uint32_t next;
+  };
+
+  std::vector<node> _nodes;
+  std::vector<std::uint32_t> _slots;
+  std::uint32_t _free = NIL;
+  std::size_t _size = 0;
+  double _width;
+  std::size_t _mask;
+  // Earliest event and its day, valid while the queue is not empty. The
+  // event is the head of the slot of _day.
+  std::uint32_t _top = NIL;
+  std::int64_t _day = 0;
+
+public:
+  /**
+   * @brief Constructs an empty queue.
+   *
+   * @param capacity Maximum number of pending events
+   * @param width Length of one day (slot), ideally close to the typical
+   * spacing between consecutive events
+   *
+   * @throws std::runtime_error if `width` is not positive and finite
+   */
+  calendar_queue(std::size_t capacity, double width)
+      : _nodes(capacity), _width(width)
+  {
+    if (!(width > 0) || !std::isfinite(width))
+      throw std::runtime_error("calendar_queue: width must be positive");
+    std::size_t slots = 16;
+    while (slots < capacity)
+      slots *= 2;
+    _slots.assign(slots, NIL);
+    _mask = slots - 1;
+    for (std::size_t i = capacity; i-- > 0;)
+    {
+      _nodes[i].next = _free;
+      _free = static_cast<std::uint32_t>(i);
+    }
+  }
+
+  //------- GETTERS -------//
+  /// @brief Returns whether no event is pending.
+  [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+  /// @brief Returns the number of pending events.
+  [[nodiscard]] std::size_t size() const noexcept { return _size; }
+  /// @brief Returns the maximum number of pending events.
+  [[nodiscard]] std::size_t capacity() const noexcept { return _nodes.size(); }
+  /// @brief Returns the length of one day.
+  [[nodiscard]] double get_width() const noexcept { return _width; }
+
+  /**
+   * @brief Adds event `id` at `time`.
+   *
+   * @throws std::runtime_error if the queue is full
+   */
+  void push(double time, id_type id)
+  {
+    if (_free == NIL)
+      throw std::runtime_error("calendar_queue: capacity exceeded");
+    const std::uint32_t n = _free;
+    _free = _nodes[n].next;
+    _nodes[n].time = time;
+    _nodes[n].id = id;
+
+    const std::int64_t day = day_of(time);
+    std::uint32_t *link = &_slots[slot_of(day)];
+    while (*link != NIL && !(time < _nodes[*link].time))
+      link = &_nodes[*link].next;
+    _nodes[n].next = *link;
+    *link = n;
+
+    if (_size == 0 || time < _nodes[_top].time)
+    {
+      _top = n;
+      _day = day;
+    }
+    _size++;
+  }
+
+  /// @brief Returns the time of the earliest event. The queue must not be
+  /// empty.
+  [[nodiscard]] double top_time() const noexcept { return _nodes[_top].time; }
+
+  /**
+   * @brief Removes the earliest event. The queue must not be empty.
+   *
+   * @return Its time and id
+   */
+  std::pair<double, id_type> pop()
+  {
+    const std::uint32_t n = _top;
+    _slots[slot_of(_day)] = _nodes[n].next;
+    _nodes[n].next = _free;
+    _free = n;
+    _size--;
+    if (_size > 0)
+      _top = top_slot_head();
+    return {_nodes[n].time, _nodes[n].id};
+  }
+
+private:
+  std::int64_t day_of(double time) const noexcept
+  {
+    return static_cast<std::int64_t>(std::floor(time / _width));
+  }
+
+  std::size_t slot_of(std::int64_t day) const noexcept
+  {
+    return static_cast<std::size_t>(day) & _mask;
+  }
+
+  // Head of the slot holding the earliest event; advances _day to its day.
+  std::uint32_t top_slot_head()
+  {
+    for (std::size_t k = 0; k <= _mask; k++, _day++)
+    {
+      const std::uint32_t head = _slots[slot_of(_day)];
+      if (head != NIL && day_of(_nodes[head].time) == _day)
+        return head;
+    }
+
+    // A whole year without an event: jump to the earliest head.
+    std::uint32_t best = NIL;
+    for (std::uint32_t head : _slots)
+      if (head != NIL && (best == NIL || _nodes[head].time < _nodes[best].time))
+        best = head;
+    _day = day_of(_nodes[best].time);
+    return best;
+  }
+};
+
+/**
+ * @brief A stochastic simulation (SSA) engine for reactions that complete
+ * after a delay.
+ *
+ * Immediate firings are drawn with the direct method from a `bucket` over the
+ * propensities. Delayed completions wait in a `calendar_queue`. Each step
+ * compares the next direct-method firing time with the earliest pending
+ * completion, and carries out whichever comes first. When a completion comes
+ * first, the drawn firing time is discarded. This is exact because
+ * exponential waiting times are memoryless.
+ *
+ * `set_propensity()` only stores the value and marks its row dirty, in O(1).
+ * Before the next draw, every dirty row is summed once and the cumulative
+ * sums are refreshed once. All completions at the same time (or within the
+ * batch window, see `set_batch_window()`) are carried out back to back, so
+ * their propensity changes share that single refresh.
+ *
+ * The engine allocates only in its constructor. The callbacks are invoked
+ * in place, and `schedule()` takes nodes from the pool of the queue.
+ *
+ * ### Example:
+ * ```
+ * delay_ssa<double> ssa(propensities, 1 << 16, 0.1);
+ * ssa.run_until(100.0, rng,
+ *     [&](std::size_t r) { ... ssa.schedule(tau, id); ... },  // fire
+ *     [&](std::uint32_t id) { ... ssa.set_propensity(r, a); }); // complete
+ * ```
+ *
+ * @tparam T Floating-point propensity type
+ */
+template <std::floating_point T = double> class delay_ssa
+{
+public:
+  using value_type = T;
+  using id_type = calendar_queue::id_type;
+
+private:
+  owning_bucket<std::vector<T>> _bucket;
+  std::vector<std::uint8_t> _row_dirty;
+  std::vector<std::size_t> _dirty_rows;
+  calendar_queue _queue;
+  double _now = 0;
+  double _window = 0;
+  std::size_t _fired = 0;
+  std::size_t _completed = 0;
+
+public:
+  /**
+   * @brief Constructs the engine at time 0.
+   *
+   * @param propensities Initial propensity of every reaction (moved in)
+   * @param max_pending Maximum number of pending delayed events
+   * @param day_width Day length of the queue, ideally close to the typical
+   * spacing between consecutive completions
+   */
+  delay_ssa(std::vector<T> propensities, std::size_t max_pending,
+            double day_width)
+      : _bucket(std::move(propensities)),
+        _row_dirty(_bucket.get().get_rows(), 0),
+        _queue(max_pending, day_width)
+  {
+    _dirty_rows.reserve(_bucket.get().get_rows());
+  }
+
+  //------- GETTERS -------//
+  /// @brief Returns the current simulation time.
+  [[nodiscard]] double get_time() const noexcept { return _now; }
+  /// @brief Returns the number of reactions.
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return _bucket.values().size();
+  }
+  /// @brief Returns the propensity of reaction `r`.
+  [[nodiscard]] T get_propensity(std::size_t r) const noexcept
+  {
+    return _bucket.values()[r];
+  }
+  /// @brief Returns the number of pending delayed events.
+  [[nodiscard]] std::size_t pending() const noexcept { return _queue.size(); }
+  /// @brief Returns the number of reactions fired so far.
+  [[nodiscard]] std::size_t get_fired() const noexcept { return _fired; }
+  /// @brief Returns the number of delayed events completed so far.
+  [[nodiscard]] std::size_t get_completed() const noexcept
+  {
+    return _completed;
+  }
+  /// @brief Returns the batch window (0 by default).
+  [[nodiscard]] double get_batch_window() const noexcept { return _window; }
+
+  /// @brief Sets the propensity of reaction `r`. O(1), the row is summed
+  /// before the next draw.
+  void set_propensity(std::size_t r, T propensity)
+  {
+    _bucket.values()[r] = propensity;
+    const std::size_t row = r / _bucket.get().get_cols();
+    if (!_row_dirty[row])
+    {
+      _row_dirty[row] = 1;
+      _dirty_rows.push_back(row);
+    }
+  }
+
+  /**
+   * @brief Schedules delayed event `id` to complete `delay` after the current
+   * time.
+   *
+   * @throws std::runtime_error if `max_pending` events are already pending
+   */
+  void schedule(double delay, id_type id) { _queue.push(_now + delay, id); }
+
+  /**
+   * @brief Carries out delayed events that complete up to `window` after the
+   * earliest one in a single step, before the next draw.
+   *
+   * With 0 (the default), only completions at exactly the same time are
+   * grouped, and the simulation is exact. A positive window assumes that no
+   * reaction fires between the grouped completions. This trades an error of
+   * about `total propensity * window` per step for fewer refreshes.
+   */
+  void set_batch_window(double window) noexcept
+  {
+    _window = window > 0 ? window : 0;
+  }
+
+  /**
+   * @brief Advances to the next event: either one reaction firing or a group
+   * of delayed completions.
+   *
+   * @param fire Called as `fire(r)` when reaction `r` fires
+   * @param complete Called as `complete(id)` for each completion, at its own
+   * time
+   * @return false if nothing can happen anymore (no propensity, nothing
+   * pending)
+   */
+  template <std::uniform_random_bit_generator URBG, typename Fire,
+            typename Complete>
+  bool step(URBG &rng, Fire &&fire, Complete &&complete)
+  {
+    return advance(std::numeric_limits<double>::infinity(), rng, fire,
+                   complete);
+  }
+
+  /**
+   * @brief Steps until the next event would happen after `end`, then sets
+   * the time to `end`.
+   *
+   * @return The number of steps taken
+   */
+  template <std::uniform_random_bit_generator URBG, typename Fire,
+            typename Complete>
+  std::size_t run_until(double end, URBG &rng, Fire &&fire,
+                        Complete &&complete)
+  {
+    std::size_t steps = 0;
+    while (advance(end, rng, fire, complete))
+      steps++;
+    if (_now < end)
+      _now = end;
+    return steps;
+  }
+
+private:
+  // Sums the dirty rows and refreshes the cumulative sums once.
+  void refresh()
+  {
+    if (_dirty_rows.empty())
+      return;
+    for (std::size_t row : _dirty_rows)
+    {
+      _bucket.get().update_sum_at_row(row);
+      _row_dirty[row] = 0;
+    }
+    _dirty_rows.clear();
+    _bucket.get().refresh_cumsum();
+  }
+
+  // One step, unless the next event happens after `horizon`.
+  template <typename URBG, typename Fire, typename Complete>
+  bool advance(double horizon, URBG &rng, Fire &fire, Complete &complete)
+  {
+    refresh();
+    const double total = static_cast<double>(_bucket.get().get_total());
+    double next_fire = std::numeric_limits<double>::infinity();
+    if (total > 0)
+      next_fire = _now + std::exponential_distribution<double>(total)(rng);
+
+    const double first = _queue.empty()
+                             ? std::numeric_limits<double>::infinity()
+                             : _queue.top_time();
+    if (!_queue.empty() && first <= next_fire)
+    {
+      if (first > horizon)
+        return false;
+      const double last = std::min(first + _window, horizon);
+      do
+      {
+        const auto [time, id] = _queue.pop();
+        _now = time;
+        _completed++;
+        complete(id);
+      } while (!_queue.empty() && _queue.top_time() <= last);
+      return true;
+    }
+
+    if (!(next_fire <= horizon))
+      return false;
+    const std::size_t r = _bucket.get().sample(rng);
+    if (r == _bucket.get().NOT_FOUND)
+      return false;
+    _now = next_fire;
+    _fired++;
+    fire(r);
+    return true;
+  }
+};
+} // namespace bucketlib
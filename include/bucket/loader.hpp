@@ -0,0 +1,451 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bucketlib
+{
+
+/**
+ * @brief Allocator that default-initializes elements, so that resizing a
+ * vector of arithmetic values does not write zeros that are about to be
+ * overwritten anyway.
+ */
+template <typename T> struct default_init_allocator : std::allocator<T>
+{
+  template <typename U> struct rebind
+  {
+    using other = default_init_allocator<U>;
+  };
+
+  default_init_allocator() = default;
+  template <typename U>
+  constexpr default_init_allocator(const default_init_allocator<U> &) noexcept
+  {
+  }
+
+  template <typename U> void construct(U *p) noexcept
+  {
+    ::new (static_cast<void *>(p)) U;
+  }
+  template <typename U, typename... Args> void construct(U *p, Args &&...args)
+  {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
+/// @brief Options of `load_raw()` and `load_npy()`.
+struct load_options
+{
+  /// Number of reader threads, each owning a contiguous range of rows.
+  std::size_t threads = 1;
+  /// Bytes read per request (rounded to whole rows).
+  std::size_t chunk_bytes = std::size_t{8} << 20;
+  /// Bypass the page cache with `O_DIRECT` when the file system supports it.
+  bool direct_io = false;
+};
+
+/**
+ * @brief Weights loaded from a file, together with their row sums.
+ *
+ * Construct the bucket with `make_bucket()`, which reuses the row sums
+ * computed while reading instead of reading the data a second time.
+ */
+template <Numeric T> struct loaded_weights
+{
+  using container_type = std::vector<T, default_init_allocator<T>>;
+
+  container_type values;
+  std::size_t rows = 0;
+  std::size_t cols = 0;
+  std::vector<T> row_sums;
+
+  /// @brief Builds a bucket over `values` from a copy of the precomputed
+  /// row sums. The bucket refers to `values`, so it must not outlive this
+  /// object, and calling this on a temporary does not compile.
+  [[nodiscard]] bucket<container_type> make_bucket() const &
+  {
+    return bucket<container_type>(rows, cols, values, row_sums);
+  }
+  bucket<container_type> make_bucket() const && = delete;
+};
+
+namespace detail
+{
+inline constexpr std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
+[[noreturn]] inline void throw_io_error(const std::string &what,
+                                        const std::string &path)
+{
+  throw std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+// Owns a file descriptor.
+class file
+{
+  int _fd = -1;
+  bool _direct = false;
+
+public:
+  file(const std::string &path, bool direct)
+  {
+#ifdef O_DIRECT
+    if (direct)
+    {
+      _fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+      _direct = _fd >= 0;
+    }
+#endif
+    if (_fd < 0)
+      _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd < 0)
+      throw_io_error("Cannot open", path);
+  }
+  file(const file &) = delete;
+  file &operator=(const file &) = delete;
+  ~file() { ::close(_fd); }
+
+  int fd() const noexcept { return _fd; }
+  bool direct() const noexcept { return _direct; }
+
+  std::size_t size(const std::string &path) const
+  {
+    struct stat st;
+    if (::fstat(_fd, &st) != 0)
+      throw_io_error("Cannot stat", path);
+    return static_cast<std::size_t>(st.st_size);
+  }
+
+  // Reads exactly `count` bytes unless the end of the file is reached first.
+  std::size_t read_at(void *buffer, std::size_t count, std::size_t offset,
+                      const std::string &path) const
+  {
+    auto *out = static_cast<char *>(buffer);
+    std::size_t done = 0;
+    while (done < count)
+    {
+      const ssize_t got = ::pread(_fd, out + done, count - done,
+                                  static_cast<off_t>(offset + done));
+      if (got < 0 && errno == EINTR)
+        continue;
+      if (got < 0)
+        throw_io_error("Cannot read", path);
+      if (got == 0)
+        break;
+      done += static_cast<std::size_t>(got);
+    }
+    return done;
+  }
+};
+
+template <typename T> void byteswap_all(T *begin, std::size_t count) noexcept
+{
+  for (std::size_t i = 0; i < count; i++)
+  {
+    auto *bytes = reinterpret_cast<unsigned char *>(begin + i);
+    std::reverse(bytes, bytes + sizeof(T));
+  }
+}
+
+/*
+Reads `count` elements stored from byte `offset` of the file into `values`,
+and fills `row_sums`. Every thread owns a contiguous range of rows and reads it
+in chunks of whole rows, summing each chunk while it is still in cache.
+*/
+template <typename T>
+void read_rows(const file &in, const std::string &path, std::size_t offset,
+               bool swap_bytes, loaded_weights<T> &out,
+               const load_options &options)
+{
+  const std::size_t count = out.values.size();
+  const std::size_t row_bytes = out.cols * sizeof(T);
+  const std::size_t chunk_rows =
+      std::max<std::size_t>(options.chunk_bytes / row_bytes, 1);
+
+  auto work = [&](std::size_t first_row, std::size_t last_row)
+  {
+    std::unique_ptr<char, void (*)(char *)> bounce(
+        nullptr, [](char *p)
+        { ::operator delete[](p, std::align_val_t{DIRECT_IO_ALIGNMENT}); });
+    if (in.direct())
+      bounce.reset(static_cast<char *>(::operator new[](
+          chunk_rows * row_bytes + 2 * DIRECT_IO_ALIGNMENT,
+          std::align_val_t{DIRECT_IO_ALIGNMENT})));
+
+    for (std::size_t row = first_row; row < last_row; row += chunk_rows)
+    {
+      const std::size_t end_row = std::min(row + chunk_rows, last_row);
+      const std::size_t first = row * out.cols;
+      const std::size_t last = std::min(end_row * out.cols, count);
+      if (first >= last)
+        break;
+      T *dest = out.values.data() + first;
+      const std::size_t bytes = (last - first) * sizeof(T);
+      const std::size_t position = offset + first * sizeof(T);
+
+      std::size_t got;
+      if (in.direct())
+      {
+        const std::size_t aligned = position / DIRECT_IO_ALIGNMENT *
+                                    DIRECT_IO_ALIGNMENT;
+        const std::size_t span =
+            (position + bytes - aligned + DIRECT_IO_ALIGNMENT - 1) /
+            DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        got = in.read_at(bounce.get(), span, aligned, path);
+        got = got > position - aligned ? got - (position - aligned) : 0;
+        got = std::min(got, bytes);
+        std::memcpy(dest, bounce.get() + (position - aligned), got);
+      }
+      else
+      {
+        got = in.read_at(dest, bytes, position, path);
+      }
+      if (got != bytes)
+        throw std::runtime_error("Unexpected end of file '" + path + "'");
+      if (swap_bytes)
+        byteswap_all(dest, last - first);
+
+      for (std::size_t r = row; r < end_row; r++)
+      {
+        const std::size_t b = std::min(r * out.cols, count);
+        const std::size_t e = std::min(b + out.cols, count);
+        out.row_sums[r] =
+            std::accumulate(out.values.data() + b, out.values.data() + e,
+                            static_cast<T>(0));
+      }
+    }
+  };
+
+  const std::size_t threads =
+      std::clamp<std::size_t>(options.threads, 1, out.rows);
+  const std::size_t rows_per_thread = (out.rows + threads - 1) / threads;
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  for (std::size_t t = 1; t < threads; t++)
+    pool.emplace_back(
+        [&, t]
+        {
+          try
+          {
+            work(t * rows_per_thread,
+                 std::min((t + 1) * rows_per_thread, out.rows));
+          }
+          catch (...)
+          {
+            std::lock_guard lock(error_mutex);
+            error = std::current_exception();
+          }
+        });
+  try
+  {
+    work(0, std::min(rows_per_thread, out.rows));
+  }
+  catch (...)
+  {
+    std::lock_guard lock(error_mutex);
+    error = std::current_exception();
+  }
+  for (std::thread &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+template <typename T>
+loaded_weights<T> load(const file &in, const std::string &path,
+                       std::size_t offset, std::size_t count, bool swap_bytes,
+                       std::size_t cols, const load_options &options)
+{
+  using bucket_type = bucket<typename loaded_weights<T>::container_type>;
+
+  loaded_weights<T> out;
+  out.cols = cols > 0 ? cols : bucket_type::default_cols(count);
+  out.rows = std::max<std::size_t>((count + out.cols - 1) / out.cols, 1);
+  out.values.resize(count);
+  out.row_sums.assign(out.rows, static_cast<T>(0));
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  ::posix_fadvise(in.fd(), static_cast<off_t>(offset),
+                  static_cast<off_t>(count * sizeof(T)),
+                  POSIX_FADV_SEQUENTIAL);
+  ::posix_fadvise(in.fd(), static_cast<off_t>(offset),
+                  static_cast<off_t>(count * sizeof(T)), POSIX_FADV_WILLNEED);
+#endif
+
+  if (count > 0)
+    read_rows(in, path, offset, swap_bytes, out, options);
+  return out;
+}
+
+// The NumPy dtype descriptor (without byte order) matching T, e.g. "f8".
+template <typename T> std::string npy_descr()
+{
+  const char kind = std::is_floating_point_v<T> ? 'f'
+                    : std::is_signed_v<T>       ? 'i'
+                                                : 'u';
+  return kind + std::to_string(sizeof(T));
+}
+
+// Returns the text following `'key':` in a NumPy header dictionary.
+inline std::string npy_field(const std::string &header, const std::string &key,
+                             const std::string &path)
+{
+  const std::size_t at = header.find("'" + key + "'");
+  const std::size_t colon =
+      at == std::string::npos ? at : header.find(':', at);
+  if (colon == std::string::npos)
+    throw std::runtime_error("Missing '" + key + "' in .npy header of '" +
+                             path + "'");
+  const std::size_t begin = header.find_first_not_of(' ', colon + 1);
+  return begin == std::string::npos ? std::string{} : header.substr(begin);
+}
+} // namespace detail
+
+/**
+ * @brief Loads a raw array of little-endian `T` values and computes the row
+ * sums while reading.
+ *
+ * The file is read with positional reads in large chunks of whole rows,
+ * optionally on several threads (each owning a range of rows) and with
+ * `O_DIRECT`, after `posix_fadvise` sequential/read-ahead hints. Every chunk
+ * is summed as soon as it arrives, so the bucket is ready once the last byte
+ * is read:
+ * ```
+ * auto weights = bucketlib::load_raw<double>("weights.bin");
+ * auto b = weights.make_bucket();
+ * ```
+ *
+ * @param path File to read
+ * @param cols Number of columns of the bucket (0 chooses the default shape)
+ * @param options Threads, chunk size and `O_DIRECT`
+ * @throws std::runtime_error if the file cannot be read or its size is not a
+ * multiple of `sizeof(T)`
+ */
+template <Numeric T>
+[[nodiscard]] loaded_weights<T> load_raw(const std::string &path,
+                                         std::size_t cols = 0,
+                                         const load_options &options = {})
+{
+  const detail::file in(path, options.direct_io);
+  const std::size_t bytes = in.size(path);
+  if (bytes % sizeof(T) != 0)
+    throw std::runtime_error("Size of '" + path +
+                             "' is not a multiple of the element size");
+  return detail::load<T>(in, path, 0, bytes / sizeof(T),
+                         std::endian::native != std::endian::little, cols,
+                         options);
+}
+
+/**
+ * @brief Loads a NumPy `.npy` file (format versions 1 to 3) of C-ordered `T`
+ * values, like `load_raw()`.
+ *
+ * Arrays of any shape are read as their flattened C-order sequence. The dtype
+ * must match `T` exactly (e.g. `<f8` for `double`); either byte order is
+ * accepted.
+ *
+ * @throws std::runtime_error if the file cannot be read, is not a valid
+ * `.npy` file, or its dtype does not match `T`
+ */
+template <Numeric T>
+[[nodiscard]] loaded_weights<T> load_npy(const std::string &path,
+                                         std::size_t cols = 0,
+                                         const load_options &options = {})
+{
+  const detail::file in(path, options.direct_io);
+  const std::size_t bytes = in.size(path);
+
+  // The preamble is read through a small aligned buffer (for O_DIRECT).
+  std::unique_ptr<char, void (*)(char *)> buffer(
+      static_cast<char *>(::operator new[](
+          detail::DIRECT_IO_ALIGNMENT,
+          std::align_val_t{detail::DIRECT_IO_ALIGNMENT})),
+      [](char *p)
+      { ::operator delete[](p, std::align_val_t{detail::DIRECT_IO_ALIGNMENT}); });
+  const std::size_t got =
+      in.read_at(buffer.get(), detail::DIRECT_IO_ALIGNMENT, 0, path);
+  const auto *preamble = reinterpret_cast<const unsigned char *>(buffer.get());
+  if (got < 10 || std::memcmp(preamble, "\x93NUMPY", 6) != 0)
+    throw std::runtime_error("'" + path + "' is not a .npy file");
+
+  const unsigned major = preamble[6];
+  std::size_t header_begin = 10;
+  std::size_t header_length = preamble[8] | (std::size_t{preamble[9]} << 8);
+  if (major >= 2)
+  {
+    header_begin = 12;
+    header_length |= (std::size_t{preamble[10]} << 16) |
+                     (std::size_t{preamble[11]} << 24);
+  }
+
+  std::string header(header_length, '\0');
+  if (header_begin + header_length <= got)
+    std::memcpy(header.data(), buffer.get() + header_begin, header_length);
+  else
+  {
+    const detail::file plain(path, false);
+    if (plain.read_at(header.data(), header_length, header_begin, path) !=
+        header_length)
+      throw std::runtime_error("Truncated .npy header in '" + path + "'");
+  }
+
+  const std::string descr = detail::npy_field(header, "descr", path);
+  const std::string expected = detail::npy_descr<T>();
+  if (descr.size() < expected.size() + 3 ||
+      descr.compare(2, expected.size(), expected) != 0 ||
+      descr[2 + expected.size()] != '\'')
+    throw std::runtime_error("dtype of '" + path + "' does not match " +
+                             expected);
+  const char order = descr[1];
+  const bool big_endian =
+      order == '>' || (order == '=' && std::endian::native == std::endian::big);
+  const bool swap_bytes =
+      sizeof(T) > 1 && order != '|' &&
+      big_endian != (std::endian::native == std::endian::big);
+
+  const std::string shape = detail::npy_field(header, "shape", path);
+  std::size_t count = 1;
+  std::size_t dimensions = 0;
+  for (std::size_t i = 1; i < shape.size() && shape[i] != ')'; i++)
+  {
+    if (shape[i] < '0' || shape[i] > '9')
+      continue;
+    std::size_t extent = 0;
+    for (; i < shape.size() && shape[i] >= '0' && shape[i] <= '9'; i++)
+      extent = extent * 10 + static_cast<std::size_t>(shape[i] - '0');
+    count *= extent;
+    dimensions++;
+    i--;
+  }
+  if (dimensions > 1 &&
+      detail::npy_field(header, "fortran_order", path).starts_with("True"))
+    throw std::runtime_error("Fortran-ordered arrays are not supported ('" +
+                             path + "')");
+
+  const std::size_t offset = header_begin + header_length;
+  if (offset + count * sizeof(T) > bytes)
+    throw std::runtime_error("Truncated .npy data in '" + path + "'");
+  return detail::load<T>(in, path, offset, count, swap_bytes, cols, options);
+}
+} // namespace bucketlib
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace bucketlib
+{
+
+/**
+ * @brief A lottery scheduler picking one of many queues with probability
+ * proportional to its tickets, for tickets that change on every enqueue and
+ * dequeue.
+ *
+ * The tickets live in a lazily refreshed `bucket`. Ticket changes only store
+ * the new value and mark its row dirty, in O(1). Before the next pick, every
+ * dirty row is summed once, however many of its queues changed, and the
+ * cumulative sums are then extended only as far as the pick needs.
+ *
+ * Other threads (enqueuers) never touch the bucket. They collect ticket
+ * deltas in a thread-local `batch` and hand over whole batches with a single
+ * lock. The scheduler thread applies the handed-over batches before its next
+ * pick. Because deltas add up, batches can be applied in any order.
+ *
+ * ### Example:
+ * ```
+ * lottery_scheduler<double> s(4096);
+ * // Enqueuer thread:
+ * lottery_scheduler<double>::batch b(s);
+ * b.add(queue, 1.0);
+ * b.submit();
+ * // Scheduler thread:
+ * std::size_t q = s.pick(rng);
+ * s.add_tickets(q, -1.0);
+ * ```
+ *
+ * @tparam T Arithmetic ticket type
+ *
+ * @note All members except `submit()` (and `batch`) must be called from one
+ * (scheduler) thread. Tickets must be non-negative once all submitted deltas
+ * are applied.
+ * @note The scheduler is neither copyable nor movable, since its batches
+ * refer to it and hand over through its mutex.
+ */
+template <Numeric T = double> class lottery_scheduler
+{
+public:
+  using value_type = T;
+  /// @brief A ticket delta for one queue.
+  using update = std::pair<std::size_t, T>;
+
+  /// @brief Sentinel index returned when no queue holds tickets.
+  static constexpr std::size_t NOT_FOUND = bucket<std::vector<T>>::NOT_FOUND;
+
+  /**
+   * @brief Per-thread buffer of ticket deltas, handed over to the scheduler
+   * when full, on `submit()` and on destruction.
+   */
+  class batch
+  {
+    lottery_scheduler &_owner;
+    std::vector<update> _updates;
+    std::size_t _capacity;
+
+  public:
+    explicit batch(lottery_scheduler &owner, std::size_t capacity = 256)
+        : _owner(owner), _capacity(std::max<std::size_t>(capacity, 1))
+    {
+      _updates.reserve(_capacity);
+    }
+    ~batch() { submit(); }
+
+    batch(const batch &) = delete;
+    batch &operator=(const batch &) = delete;
+
+    /// @brief Adds `delta` tickets to `queue` (negative to remove).
+    void add(std::size_t queue, T delta)
+    {
+      _updates.emplace_back(queue, delta);
+      if (_updates.size() == _capacity)
+        submit();
+    }
+
+    /// @brief Hands the buffered deltas over to the scheduler.
+    void submit()
+    {
+      if (!_updates.empty())
+        _owner.submit(_updates);
+    }
+  };
+
+private:
+  owning_bucket<std::vector<T>> _bucket;
+  std::vector<std::uint8_t> _row_dirty;
+  std::vector<std::size_t> _dirty_rows;
+
+  std::mutex _mutex;
+  std::vector<update> _pending; // guarded by _mutex
+  std::vector<update> _applying;
+  std::atomic<bool> _has_pending{false};
+
+public:
+  /**
+   * @brief Constructs the scheduler with the given tickets per queue.
+   *
+   * @param tickets Initial tickets (moved in)
+   */
+  explicit lottery_scheduler(std::vector<T> tickets)
+      : _bucket(std::move(tickets)), _row_dirty(_bucket.get().get_rows(), 0)
+  {
+    _bucket.get().set_lazy_refresh(true);
+  }
+
+  /// @brief Constructs the scheduler for `queues` queues holding `initial`
+  /// tickets each.
+  explicit lottery_scheduler(std::size_t queues, T initial = T{})
+      : lottery_scheduler(std::vector<T>(queues, initial))
+  {
+  }
+
+  lottery_scheduler(const lottery_scheduler &) = delete;
+  lottery_scheduler &operator=(const lottery_scheduler &) = delete;
+
+  //------- GETTERS -------//
+  /// @brief Returns the number of queues.
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return _bucket.values().size();
+  }
+  /// @brief Returns the tickets of `queue`, without pending batches.
+  [[nodiscard]] T get_tickets(std::size_t queue) const noexcept
+  {
+    return _bucket.values()[queue];
+  }
+  /// @brief Returns the total number of tickets as of the last `refresh()`
+  /// (or pick).
+  [[nodiscard]] T get_total() const noexcept
+  {
+    return _bucket.get().get_total();
+  }
+
+  /// @brief Sets the tickets of `queue`. O(1), the row is summed before the
+  /// next pick.
+  void set_tickets(std::size_t queue, T tickets)
+  {
+    _bucket.values()[queue] = tickets;
+    mark_dirty(queue);
+  }
+
+  /// @brief Adds `delta` tickets to `queue` (negative to remove). O(1).
+  void add_tickets(std::size_t queue, T delta)
+  {
+    _bucket.values()[queue] += delta;
+    mark_dirty(queue);
+  }
+
+  /**
+   * @brief Hands a batch of deltas over to the scheduler and clears it.
+   *
+   * Thread-safe. The deltas are applied before the next pick. They are
+   * copied, so `updates` keeps its capacity, and the scheduler's buffers
+   * stop growing once they have held the largest backlog.
+   */
+  void submit(std::vector<update> &updates)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _pending.insert(_pending.end(), updates.begin(), updates.end());
+      _has_pending.store(true, std::memory_order_release);
+    }
+    updates.clear();
+  }
+
+  /**
+   * @brief Applies the submitted batches and re-sums the dirty rows.
+   *
+   * Called by `pick()`. The cumulative sums are still refreshed lazily.
+   */
+  void refresh()
+  {
+    if (_has_pending.load(std::memory_order_acquire))
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _applying.swap(_pending);
+        _has_pending.store(false, std::memory_order_relaxed);
+      }
+      for (const auto &[queue, delta] : _applying)
+        add_tickets(queue, delta);
+      _applying.clear();
+    }
+
+    for (std::size_t row : _dirty_rows)
+    {
+      _bucket.get().update_sum_at_row(row);
+      _row_dirty[row] = 0;
+    }
+    _dirty_rows.clear();
+  }
+
+  /**
+   * @brief Picks a queue with probability proportional to its tickets.
+   *
+   * @return Queue index, or NOT_FOUND if no queue holds tickets
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] std::size_t pick(URBG &rng)
+  {
+    refresh();
+    return _bucket.get().sample(rng);
+  }
+
+private:
+  void mark_dirty(std::size_t queue)
+  {
+    const std::size_t row = queue / _bucket.get().get_cols();
+    if (!_row_dirty[row])
+    {
+      _row_dirty[row] = 1;
+      _dirty_rows.push_back(row);
+    }
+  }
+};
+} // namespace bucketlib
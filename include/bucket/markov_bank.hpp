@@ -0,0 +1,318 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace bucketlib
+{
+
+/**
+ * @brief The transition weights of a large sparse Markov chain, with one
+ * `bucket`-style summary per state, all stored in a few contiguous arenas.
+ *
+ * The weights are kept in compressed sparse row (CSR) form: the transitions
+ * of state `s` are `[offset(s), offset(s + 1))` of one weight arena, with
+ * their target states in a parallel arena. Each state's transitions are
+ * split into rows of `cols(s)` weights (chosen like `bucket::default_cols()`
+ * for its out-degree), whose row sums and cumulative sums live in two more
+ * shared arenas:
+ * ```
+ *   weights : | s0: w w w w w | s1: w w | s2: w w w w w w w w w | ...
+ *   sums    : | s0: r r       | s1: r   | s2: r r r             | ...
+ *   cums    : | s0: 0 c c     | s1: 0 c | s2: 0 c c c           | ...
+ * ```
+ * A step reads three adjacent stretches of memory, instead of following a
+ * pointer per state to separately allocated `bucket`s and their containers.
+ *
+ * Editing one weight re-sums its row and refreshes the cumulative sums of
+ * its own state only, in `O(cols(s) + rows(s))`. A step searches a state's
+ * cumulative sums and scans its row with the policies of a default
+ * `bucket<std::vector<T>>`, so both agree on every boundary.
+ *
+ * @tparam T Arithmetic weight type
+ *
+ * @note A state without positive outgoing weight is absorbing: stepping from
+ * it stays in place.
+ */
+template <Numeric T> class markov_bank
+{
+public:
+  using value_type = T;
+  using state_type = std::uint32_t;
+
+  /// @brief Sentinel position returned when a transition does not exist.
+  static constexpr std::size_t NOT_FOUND =
+      std::numeric_limits<std::size_t>::max();
+
+private:
+  std::vector<std::size_t> _offsets;
+  std::vector<state_type> _targets;
+  std::vector<T> _weights;
+  std::vector<std::uint32_t> _cols;
+  // Start of every state's cumulative sums (rows + 1 entries) in _cums. Its
+  // row sums start at _cum_offsets[s] - s in _sums.
+  std::vector<std::size_t> _cum_offsets;
+  std::vector<T> _sums;
+  std::vector<T> _cums;
+  // Walkers grouped by state for step_many(): per state the first walker of
+  // its list (or NO_WALKER), per walker the next one in the same state.
+  std::vector<std::size_t> _group_head;
+  std::vector<std::size_t> _group_next;
+  std::vector<state_type> _group_states;
+
+  static constexpr std::size_t NO_WALKER =
+      std::numeric_limits<std::size_t>::max();
+
+  using row_search = typename bucket<std::vector<T>>::row_search_policy;
+  using top_search = typename bucket<std::vector<T>>::top_search_policy;
+
+public:
+  /**
+   * @brief Constructs the bank from a CSR matrix.
+   *
+   * @param offsets `states + 1` non-decreasing offsets, starting at 0
+   * @param targets Target state of every transition
+   * @param weights Weight of every transition
+   *
+   * @throws std::runtime_error if the arrays are inconsistent
+   */
+  markov_bank(std::vector<std::size_t> offsets, std::vector<state_type> targets,
+              std::vector<T> weights)
+      : _offsets(std::move(offsets)), _targets(std::move(targets)),
+        _weights(std::move(weights))
+  {
+    if (_offsets.empty() || _offsets.front() != 0 ||
+        !std::is_sorted(_offsets.begin(), _offsets.end()) ||
+        _offsets.back() != _targets.size() ||
+        _targets.size() != _weights.size())
+      throw std::runtime_error("markov_bank: inconsistent CSR arrays");
+    const std::size_t states = _offsets.size() - 1;
+    for (state_type target : _targets)
+      if (target >= states)
+        throw std::runtime_error("markov_bank: target state out of range");
+
+    _cols.resize(states);
+    _cum_offsets.resize(states + 1);
+    std::size_t cums = 0;
+    for (std::size_t s = 0; s < states; s++)
+    {
+      const std::size_t degree = _offsets[s + 1] - _offsets[s];
+      _cols[s] = static_cast<std::uint32_t>(
+          bucket<std::vector<T>>::default_cols(degree));
+      _cum_offsets[s] = cums;
+      cums += bucket<std::vector<T>>::default_rows(degree) + 1;
+    }
+    _cum_offsets[states] = cums;
+    _cums.resize(cums);
+    _sums.resize(cums - states);
+    for (std::size_t s = 0; s < states; s++)
+      rebuild_state(s);
+    _group_head.assign(states, NO_WALKER);
+  }
+
+  /**
+   * @brief Constructs the bank from `(from, to, weight)` transitions in any
+   * order.
+   */
+  static markov_bank
+  from_transitions(std::size_t states,
+                   std::vector<std::tuple<state_type, state_type, T>> edges)
+  {
+    std::sort(edges.begin(), edges.end(),
+              [](const auto &a, const auto &b)
+              {
+                return std::tie(std::get<0>(a), std::get<1>(a)) <
+                       std::tie(std::get<0>(b), std::get<1>(b));
+              });
+    std::vector<std::size_t> offsets(states + 1, 0);
+    std::vector<state_type> targets;
+    std::vector<T> weights;
+    targets.reserve(edges.size());
+    weights.reserve(edges.size());
+    for (const auto &[from, to, weight] : edges)
+    {
+      if (from >= states)
+        throw std::runtime_error("markov_bank: source state out of range");
+      offsets[from + 1]++;
+      targets.push_back(to);
+      weights.push_back(weight);
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    return markov_bank(std::move(offsets), std::move(targets),
+                       std::move(weights));
+  }
+
+  //------- GETTERS -------//
+  /// @brief Returns the number of states.
+  [[nodiscard]] std::size_t states() const noexcept
+  {
+    return _offsets.size() - 1;
+  }
+  /// @brief Returns the number of transitions leaving `state`.
+  [[nodiscard]] std::size_t degree(std::size_t state) const noexcept
+  {
+    return _offsets[state + 1] - _offsets[state];
+  }
+  /// @brief Returns the target of the `k`-th transition leaving `state`.
+  [[nodiscard]] state_type target(std::size_t state,
+                                  std::size_t k) const noexcept
+  {
+    return _targets[_offsets[state] + k];
+  }
+  /// @brief Returns the weight of the `k`-th transition leaving `state`.
+  [[nodiscard]] T weight(std::size_t state, std::size_t k) const noexcept
+  {
+    return _weights[_offsets[state] + k];
+  }
+  /// @brief Returns the total outgoing weight of `state`.
+  [[nodiscard]] T get_total(std::size_t state) const noexcept
+  {
+    return _cums[_cum_offsets[state + 1] - 1];
+  }
+
+  /**
+   * @brief Returns the position `k` of the transition `from -> to` among the
+   * transitions leaving `from`, or NOT_FOUND.
+   *
+   * Binary search if the targets of `from` are sorted (always the case with
+   * `from_transitions()`), linear otherwise.
+   */
+  [[nodiscard]] std::size_t find_transition(std::size_t from,
+                                            state_type to) const
+  {
+    const auto first = _targets.begin() + _offsets[from];
+    const auto last = _targets.begin() + _offsets[from + 1];
+    auto it = std::is_sorted(first, last) ? std::lower_bound(first, last, to)
+                                          : std::find(first, last, to);
+    return it != last && *it == to ? static_cast<std::size_t>(it - first)
+                                   : NOT_FOUND;
+  }
+
+  /**
+   * @brief Sets the weight of the `k`-th transition leaving `state`.
+   *
+   * Re-sums the containing row and refreshes the cumulative sums of `state`
+   * from that row on. Other states are untouched.
+   */
+  void set_weight(std::size_t state, std::size_t k, T weight)
+  {
+    assert(k < degree(state));
+    _weights[_offsets[state] + k] = weight;
+
+    const std::size_t row = k / _cols[state];
+    T *sums = _sums.data() + (_cum_offsets[state] - state);
+    T *cums = _cums.data() + _cum_offsets[state];
+    sums[row] = row_sum(state, row);
+    const std::size_t rows = _cum_offsets[state + 1] - _cum_offsets[state] - 1;
+    for (std::size_t r = row; r < rows; r++)
+      cums[r + 1] = cums[r] + sums[r];
+  }
+
+  /**
+   * @brief Draws the next state from `state`.
+   *
+   * @param rng A uniform random bit generator (e.g. `std::mt19937`)
+   * @return The next state (`state` itself if it is absorbing)
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] state_type step(std::size_t state, URBG &rng) const
+  {
+    const T total = get_total(state);
+    if (!(total > 0))
+      return static_cast<state_type>(state);
+
+    return locate(state, detail::draw_target(rng, total));
+  }
+
+  /**
+   * @brief Advances every walker by one step, in place.
+   *
+   * Walkers are grouped by their current state first, in one O(walkers)
+   * pass that links the walkers of each state into a list. All walkers in
+   * one state are then stepped back to back over the same, cache-resident
+   * transitions and summaries. The draws therefore happen state by state
+   * (in order of first appearance), not walker by walker.
+   *
+   * @param walkers Current state of every walker, replaced by the next one
+   * @param rng A uniform random bit generator (e.g. `std::mt19937`)
+   */
+  template <std::uniform_random_bit_generator URBG>
+  void step_many(std::span<state_type> walkers, URBG &rng)
+  {
+    _group_next.resize(walkers.size());
+    _group_states.clear();
+    // Backwards, so every list ends up in walker order.
+    for (std::size_t w = walkers.size(); w-- > 0;)
+    {
+      const state_type state = walkers[w];
+      if (_group_head[state] == NO_WALKER)
+        _group_states.push_back(state);
+      _group_next[w] = _group_head[state];
+      _group_head[state] = w;
+    }
+
+    for (state_type state : _group_states)
+    {
+      for (std::size_t w = _group_head[state]; w != NO_WALKER;
+           w = _group_next[w])
+        walkers[w] = step(state, rng);
+      _group_head[state] = NO_WALKER;
+    }
+  }
+
+private:
+  T row_sum(std::size_t state, std::size_t row) const
+  {
+    const std::size_t first = _offsets[state] + row * _cols[state];
+    const std::size_t last =
+        std::min<std::size_t>(first + _cols[state], _offsets[state + 1]);
+    return std::accumulate(_weights.begin() + first, _weights.begin() + last,
+                           static_cast<T>(0));
+  }
+
+  void rebuild_state(std::size_t state)
+  {
+    T *sums = _sums.data() + (_cum_offsets[state] - state);
+    T *cums = _cums.data() + _cum_offsets[state];
+    const std::size_t rows = _cum_offsets[state + 1] - _cum_offsets[state] - 1;
+    cums[0] = static_cast<T>(0);
+    for (std::size_t r = 0; r < rows; r++)
+    {
+      sums[r] = row_sum(state, r);
+      cums[r + 1] = cums[r] + sums[r];
+    }
+  }
+
+  state_type locate(std::size_t state, const T &val) const
+  {
+    const T *cums = _cums.data() + _cum_offsets[state];
+    const std::size_t rows = _cum_offsets[state + 1] - _cum_offsets[state] - 1;
+    const std::size_t row = static_cast<std::size_t>(
+        top_search::find(cums + 1, cums + rows + 1, val, detail::reached<T>) -
+        cums - 1);
+
+    const std::size_t first = _offsets[state] + row * _cols[state];
+    const std::size_t length =
+        std::min<std::size_t>(first + _cols[state], _offsets[state + 1]) -
+        first;
+    const T *weights = _weights.data() + first;
+    std::size_t hit = row_search::scan(weights, length, cums[row], val);
+    if (hit == length)
+      hit = detail::last_positive(weights, length);
+    return hit < length ? _targets[first + hit]
+                        : static_cast<state_type>(state);
+  }
+};
+} // namespace bucketlib
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace bucketlib
+{
+
+/**
+ * @brief Counter-based Philox4x32-10 random number generator.
+ *
+ * Every block of four 32-bit words is a pure function of a 128-bit counter and
+ * a 64-bit key (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+ * Keying the generator by a stream id and using the draw index as counter
+ * makes the `i`-th draw of a stream independent of which thread, SIMD lane or
+ * call produced the draws before it. Work can therefore be split arbitrarily
+ * and still yield bit-identical results.
+ *
+ * The class also models `std::uniform_random_bit_generator`, so it can be used
+ * wherever `std::mt19937` is, with a state of only 32 bytes.
+ *
+ * ### Example:
+ * ```
+ * // Thread t draws samples [first, last) of stream 7:
+ * std::vector<std::size_t> out(last - first);
+ * b.sample_many(out, 7, first);
+ * ```
+ */
+class philox4x32
+{
+public:
+  using result_type = std::uint32_t;
+  using counter_type = std::array<std::uint32_t, 4>;
+  using key_type = std::array<std::uint32_t, 2>;
+
+private:
+  static constexpr std::uint32_t M0 = 0xD2511F53;
+  static constexpr std::uint32_t M1 = 0xCD9E8D57;
+  static constexpr std::uint32_t W0 = 0x9E3779B9;
+  static constexpr std::uint32_t W1 = 0xBB67AE85;
+
+  key_type _key;
+  counter_type _counter;
+  counter_type _block{};
+  std::size_t _word = 4;
+
+public:
+  /**
+   * @brief Constructs the generator of stream `stream`, positioned at block
+   * `block` (each block yields four 32-bit words).
+   */
+  explicit constexpr philox4x32(std::uint64_t stream = 0,
+                                std::uint64_t block = 0) noexcept
+      : _key(make_key(stream)), _counter(make_counter(block))
+  {
+  }
+
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept
+  {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  /// @brief Returns the next 32-bit word of the stream.
+  constexpr result_type operator()() noexcept
+  {
+    if (_word == 4)
+    {
+      _block = generate(_counter, _key);
+      increment(_counter);
+      _word = 0;
+    }
+    return _block[_word++];
+  }
+
+  /// @brief Skips `n` words.
+  constexpr void discard(unsigned long long n) noexcept
+  {
+    for (; n > 0 && _word < 4; n--)
+      _word++;
+    for (; n >= 4; n -= 4)
+      increment(_counter);
+    for (; n > 0; n--)
+      (*this)();
+  }
+
+  /// @brief Applies the ten Philox rounds to `counter` under `key`.
+  [[nodiscard]] static constexpr counter_type generate(counter_type counter,
+                                                       key_type key) noexcept
+  {
+    for (int round = 0; round < 10; round++)
+    {
+      if (round > 0)
+      {
+        key[0] += W0;
+        key[1] += W1;
+      }
+      const std::uint64_t p0 = std::uint64_t{M0} * counter[0];
+      const std::uint64_t p1 = std::uint64_t{M1} * counter[2];
+      counter = {static_cast<std::uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+                 static_cast<std::uint32_t>(p1),
+                 static_cast<std::uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+                 static_cast<std::uint32_t>(p0)};
+    }
+    return counter;
+  }
+
+  /**
+   * @brief Returns the 64 random bits of draw `draw` in stream `stream`.
+   *
+   * Two draws share one Philox block.
+   */
+  [[nodiscard]] static constexpr std::uint64_t bits(std::uint64_t stream,
+                                                    std::uint64_t draw) noexcept
+  {
+    const counter_type block =
+        generate(make_counter(draw / 2), make_key(stream));
+    const std::size_t word = 2 * (draw % 2);
+    return (std::uint64_t{block[word]} << 32) | block[word + 1];
+  }
+
+  /**
+   * @brief Fills `out` with the uniforms in (0, 1) of draws
+   * `[first_draw, first_draw + out.size())` of stream `stream`.
+   *
+   * `out[j]` equals `to_unit<T>(bits(stream, first_draw + j))`. Blocks are
+   * generated in groups of independent lanes so the compiler can vectorize the
+   * rounds.
+   */
+  template <typename T>
+  static void fill_uniform(std::uint64_t stream, std::uint64_t first_draw,
+                           std::span<T> out) noexcept
+  {
+    constexpr std::size_t LANES = 8;
+    const key_type key = make_key(stream);
+
+    std::size_t j = 0;
+    // Leading odd draw: second half of a block.
+    if (first_draw % 2 == 1 && j < out.size())
+      out[j++] = to_unit<T>(bits(stream, first_draw));
+
+    const std::uint64_t first_block = (first_draw + j) / 2;
+    for (std::size_t lane_base = 0; j + 2 * LANES <= out.size();
+         lane_base += LANES)
+    {
+      std::array<std::uint32_t, LANES> c0, c1, c2, c3;
+      for (std::size_t l = 0; l < LANES; l++)
+      {
+        const std::uint64_t block = first_block + lane_base + l;
+        c0[l] = static_cast<std::uint32_t>(block);
+        c1[l] = static_cast<std::uint32_t>(block >> 32);
+        c2[l] = 0;
+        c3[l] = 0;
+      }
+      key_type k = key;
+      for (int round = 0; round < 10; round++)
+      {
+        if (round > 0)
+        {
+          k[0] += W0;
+          k[1] += W1;
+        }
+        for (std::size_t l = 0; l < LANES; l++)
+        {
+          const std::uint64_t p0 = std::uint64_t{M0} * c0[l];
+          const std::uint64_t p1 = std::uint64_t{M1} * c2[l];
+          const std::uint32_t n0 =
+              static_cast<std::uint32_t>(p1 >> 32) ^ c1[l] ^ k[0];
+          const std::uint32_t n2 =
+              static_cast<std::uint32_t>(p0 >> 32) ^ c3[l] ^ k[1];
+          c1[l] = static_cast<std::uint32_t>(p1);
+          c3[l] = static_cast<std::uint32_t>(p0);
+          c0[l] = n0;
+          c2[l] = n2;
+        }
+      }
+      for (std::size_t l = 0; l < LANES; l++)
+      {
+        out[j++] = to_unit<T>((std::uint64_t{c0[l]} << 32) | c1[l]);
+        out[j++] = to_unit<T>((std::uint64_t{c2[l]} << 32) | c3[l]);
+      }
+    }
+
+    for (; j < out.size(); j++)
+      out[j] = to_unit<T>(bits(stream, first_draw + j));
+  }
+
+  /**
+   * @brief Maps 64 random bits to a uniform value strictly inside (0, 1).
+   *
+   * One bit less than the mantissa of `T` is used, so that the half-step
+   * offset keeps every result exactly representable and below 1.
+   */
+  template <typename T>
+  [[nodiscard]] static constexpr T to_unit(std::uint64_t bits) noexcept
+  {
+    constexpr int DIGITS = std::numeric_limits<T>::digits - 1;
+    constexpr T SCALE = static_cast<T>(1) / static_cast<T>(1ULL << DIGITS);
+    return (static_cast<T>(bits >> (64 - DIGITS)) + static_cast<T>(0.5)) *
+           SCALE;
+  }
+
+private:
+  static constexpr key_type make_key(std::uint64_t stream) noexcept
+  {
+    return {static_cast<std::uint32_t>(stream),
+            static_cast<std::uint32_t>(stream >> 32)};
+  }
+
+  static constexpr counter_type make_counter(std::uint64_t block) noexcept
+  {
+    return {static_cast<std::uint32_t>(block),
+            static_cast<std::uint32_t>(block >> 32), 0, 0};
+  }
+
+  static constexpr void increment(counter_type &counter) noexcept
+  {
+    for (std::uint32_t &word : counter)
+      if (++word != 0)
+        break;
+  }
+};
+} // namespace bucketlib
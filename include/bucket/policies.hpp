@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/**
+ * @brief Compile-time policies of `bucket`.
+ *
+ * Every policy is a plain tag type whose static members the bucket calls
+ * directly, so combinations are resolved at compile time without any runtime
+ * dispatch. The defaults reproduce the behavior of a plain `bucket<Container>`:
+ * ```
+ * bucket<Container, vector_storage, linear_row_search,
+ *        mirrored_binary_top_search, configurable_refresh, no_stats>
+ * ```
+ */
+namespace bucketlib::policy
+{
+
+//------- STORAGE -------//
+
+/**
+ * @brief Allocator returning storage aligned to a cache line.
+ *
+ * Advertises its `alignment`, so `container_alignment` picks it up when the
+ * data container itself uses this allocator.
+ */
+template <typename T> struct cache_aligned_allocator
+{
+  using value_type = T;
+  static constexpr std::size_t alignment = 64;
+
+  template <typename U> struct rebind
+  {
+    using other = cache_aligned_allocator<U>;
+  };
+
+  cache_aligned_allocator() noexcept = default;
+  template <typename U>
+  constexpr cache_aligned_allocator(const cache_aligned_allocator<U> &) noexcept
+  {
+  }
+
+  [[nodiscard]] T *allocate(std::size_t n)
+  {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t{alignment}));
+  }
+  void deallocate(T *p, std::size_t) noexcept
+  {
+    ::operator delete(p, std::align_val_t{alignment});
+  }
+
+  template <typename U>
+  bool operator==(const cache_aligned_allocator<U> &) const noexcept
+  {
+    return true;
+  }
+};
+
+/// @brief Row and cumulative sums in plain `std::vector`s (default).
+struct vector_storage
+{
+  template <typename T> using vector = std::vector<T>;
+};
+
+/// @brief Row and cumulative sums in cache-line aligned vectors, so the row
+/// search never straddles a line at the start of the sums.
+struct aligned_storage
+{
+  template <typename T>
+  using vector = std::vector<T, cache_aligned_allocator<T>>;
+};
+
+//------- ROW SEARCH -------//
+
+/// @brief Whether rows are scanned in their natural order, in descending
+/// order of weight, or as selected at runtime with `set_heavy_first()`.
+enum class row_layout
+{
+  natural,
+  heavy_first,
+  configurable
+};
+
+/**
+ * @brief Scans a row element by element (default).
+ *
+ * `scan()` adds the elements of a row to the running sum `sum` and returns
+ * the position of the first element at which `sum >= val`, or `length` if the
+ * row ends first. The overload taking `order` visits the elements in that
+ * order and returns the position within `order`.
+ */
+struct linear_row_search
+{
+  static constexpr row_layout layout = row_layout::configurable;
+
+  template <typename T>
+  static std::size_t scan(const T *row, std::size_t length, T sum,
+                          const T &val) noexcept
+  {
+    for (std::size_t i = 0; i < length; i++)
+    {
+      sum += row[i];
+      if (sum >= val)
+        return i;
+    }
+    return length;
+  }
+
+  template <typename T>
+  static std::size_t scan(const T *row, const std::uint32_t *order,
+                          std::size_t length, T sum, const T &val) noexcept
+  {
+    for (std::size_t i = 0; i < length; i++)
+    {
+      sum += row[order[i]];
+      if (sum >= val)
+        return i;
+    }
+    return length;
+  }
+};
+
+/// @brief Linear scan in descending order of weight, always enabled.
+struct heavy_first_row_search : linear_row_search
+{
+  static constexpr row_layout layout = row_layout::heavy_first;
+};
+
+/**
+ * @brief Skips over blocks of `BLOCK` elements whose (vectorizable) sum does
+ * not reach the target, and scans only the block that does.
+ *
+ * Long rows are mostly skipped at one addition per block instead of one
+ * compare-and-branch per element. With floating-point weights, the block sums
+ * round differently from the running sum, so results may differ from
+ * `linear_row_search` for targets within rounding of an element boundary. A
+ * target that a block sum reaches but its running sum does not resolves to
+ * the last positive element of that block. A miss in the trailing partial
+ * block is resolved by the bucket, which knows whether the row as a whole
+ * reaches the target.
+ */
+template <std::size_t BLOCK = 8> struct blocked_row_search
+{
+  static constexpr row_layout layout = row_layout::natural;
+
+  template <typename T>
+  static std::size_t scan(const T *row, std::size_t length, T sum,
+                          const T &val) noexcept
+  {
+    std::size_t i = 0;
+    for (; i + BLOCK <= length; i += BLOCK)
+    {
+      T block = static_cast<T>(0);
+      for (std::size_t j = 0; j < BLOCK; j++)
+        block += row[i + j];
+      if (sum + block < val)
+      {
+        sum += block;
+        continue;
+      }
+      const std::size_t hit =
+          linear_row_search::scan(row + i, BLOCK, sum, val);
+      if (hit < BLOCK)
+        return i + hit;
+      // Rounding: the block reaches the target but its running sum does not,
+      // so the target lies at the end of the block.
+      for (std::size_t j = BLOCK; j-- > 0;)
+        if (row[i + j] > 0)
+          return i + j;
+    }
+    return i + linear_row_search::scan(row + i, length - i, sum, val);
+  }
+};
+
+//------- TOP SEARCH -------//
+
+/**
+ * @brief Finds the first cumulative sum in `[first, last)` reached by `val`,
+ * with `std::upper_bound` semantics under the comparator `comp`.
+ */
+struct binary_top_search
+{
+  static constexpr bool float_mirror = false;
+
+  template <typename It, typename T, typename Compare>
+  static It find(It first, It last, const T &val, Compare comp)
+  {
+    return std::upper_bound(first, last, val, comp);
+  }
+};
+
+/// @brief `binary_top_search` that can run on a `float` mirror of the
+/// cumulative sums, enabled with `set_float_mirror()` (default).
+struct mirrored_binary_top_search : binary_top_search
+{
+  static constexpr bool float_mirror = true;
+};
+
+/**
+ * @brief Binary search whose halving step compiles to a conditional move, so
+ * the search has no data-dependent branches to mispredict.
+ */
+struct branchless_top_search
+{
+  static constexpr bool float_mirror = false;
+
+  template <typename It, typename T, typename Compare>
+  static It find(It first, It last, const T &val, Compare comp)
+  {
+    std::size_t length = static_cast<std::size_t>(last - first);
+    if (length == 0)
+      return first;
+    while (length > 1)
+    {
+      const std::size_t half = length / 2;
+      first = comp(val, first[half]) ? first : first + half;
+      length -= half;
+    }
+    return comp(val, *first) ? first : first + 1;
+  }
+};
+
+/// @brief Linear search over the cumulative sums, for buckets with few rows.
+struct linear_top_search
+{
+  static constexpr bool float_mirror = false;
+
+  template <typename It, typename T, typename Compare>
+  static It find(It first, It last, const T &val, Compare comp)
+  {
+    return std::find_if(first, last, [&](const T &x) { return comp(val, x); });
+  }
+};
+
+//------- REFRESH -------//
+
+/// @brief Eager refresh of the affected range, switchable to lazy refresh at
+/// runtime with `set_lazy_refresh()` (default).
+struct configurable_refresh
+{
+  static constexpr bool configurable = true;
+  static constexpr bool lazy = false;
+};
+
+/// @brief Always refreshes eagerly over the affected row range.
+struct eager_refresh
+{
+  static constexpr bool configurable = false;
+  static constexpr bool lazy = false;
+};
+
+/// @brief Always refreshes lazily, as far as queries need.
+struct lazy_refresh
+{
+  static constexpr bool configurable = false;
+  static constexpr bool lazy = true;
+};
+
+//------- STATS -------//
+
+/// @brief Collects nothing (default). Every hook compiles away.
+struct no_stats
+{
+  constexpr void on_update() noexcept {}
+  constexpr void on_refresh(std::size_t) noexcept {}
+  constexpr void on_query(std::size_t) noexcept {}
+};
+
+/// @brief Counts the work done by updates, refreshes and queries.
+struct counting_stats
+{
+  std::size_t updates = 0;
+  std::size_t refreshes = 0;
+  /// Cumulative sums recomputed by all refreshes.
+  std::size_t rows_refreshed = 0;
+  std::size_t queries = 0;
+  /// Elements visited by the in-row scans of all queries.
+  std::size_t elements_scanned = 0;
+
+  constexpr void on_update() noexcept { updates++; }
+  constexpr void on_refresh(std::size_t rows) noexcept
+  {
+    refreshes++;
+    rows_refreshed += rows;
+  }
+  constexpr void on_query(std::size_t scanned) noexcept
+  {
+    queries++;
+    elements_scanned += scanned;
+  }
+};
+
+} // namespace bucketlib::policy
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <bucket/bucket.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace bucketlib
+{
+
+/**
+ * @brief A two-tier sampler that migrates frequently updated indices into a
+ * small, L1-resident hot tier.
+ *
+ * When a small fraction of the indices receives most of the updates but those
+ * indices are spread over all rows, almost every `refresh_cumsum()` of a plain
+ * `bucket` spans many rows. `tiered_bucket` tracks the update frequency of
+ * every index and keeps the hottest ones in a short array of at most
+ * `hot_capacity` slots, whose total is maintained in O(1) per update. The
+ * remaining (cold) weights live in a lazily refreshed `bucket` that then
+ * rarely changes. A query first chooses between the two tiers and then
+ * searches inside the chosen one:
+ * ```
+ *   val < hot_total  -> linear scan over the hot slots
+ *   otherwise        -> cold.find_upper_bound(val - hot_total)
+ * ```
+ *
+ * Frequencies are counted per epoch of `epoch_length` updates. At the end of
+ * an epoch, cold indices updated at least `promote_threshold` times are moved
+ * into free (or colder) hot slots and hot indices updated less than half as
+ * often are moved back, so migration is amortized over the epoch. Callers
+ * always use the original indices; the translation is transparent.
+ *
+ * @tparam T Arithmetic weight type
+ */
+template <Numeric T> class tiered_bucket
+{
+public:
+  using value_type = T;
+
+private:
+  static constexpr std::uint32_t NO_SLOT =
+      std::numeric_limits<std::uint32_t>::max();
+
+  owning_bucket<std::vector<T>> _cold;
+
+  std::vector<T> _hot;
+  std::vector<std::size_t> _hot_index;
+  std::vector<std::uint32_t> _slot;
+  T _hot_total = static_cast<T>(0);
+  std::size_t _hot_capacity;
+
+  // Update counts, valid only if their epoch stamp is the current epoch.
+  std::vector<std::uint32_t> _hits;
+  std::vector<std::uint32_t> _hit_epoch;
+  std::uint32_t _epoch = 1;
+  std::size_t _epoch_length;
+  std::size_t _updates_in_epoch = 0;
+  std::uint32_t _promote_threshold;
+  std::vector<std::size_t> _candidates;
+
+public:
+  /// @brief Sentinel index returned when an upper bound is not found.
+  static constexpr std::size_t NOT_FOUND = bucket<std::vector<T>>::NOT_FOUND;
+
+  /**
+   * @brief Constructs the sampler, initially with every index in the cold
+   * tier.
+   *
+   * @param weights Initial weights (moved in)
+   * @param hot_capacity Maximum number of hot indices
+   * @param epoch_length Number of updates between migrations
+   */
+  explicit tiered_bucket(std::vector<T> weights, std::size_t hot_capacity = 64,
+                         std::size_t epoch_length = 4096)
+      : _cold(std::move(weights)), _hot_capacity(hot_capacity),
+        _epoch_length(std::max<std::size_t>(epoch_length, 1)),
+        _promote_threshold(static_cast<std::uint32_t>(std::max<std::size_t>(
+            _epoch_length / (2 * std::max<std::size_t>(hot_capacity, 1)), 4)))
+  {
+    _cold.get().set_lazy_refresh(true);
+    _slot.assign(_cold.values().size(), NO_SLOT);
+    _hits.assign(_cold.values().size(), 0);
+    _hit_epoch.assign(_cold.values().size(), 0);
+    _hot.reserve(_hot_capacity);
+    _hot_index.reserve(_hot_capacity);
+  }
+
+  //------- GETTERS -------//
+  /// @brief Returns the number of indices.
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return _cold.values().size();
+  }
+  /// @brief Returns the current weight of index `i`.
+  [[nodiscard]] T get(std::size_t i) const noexcept
+  {
+    return _slot[i] == NO_SLOT ? _cold.values()[i] : _hot[_slot[i]];
+  }
+  /// @brief Returns whether index `i` currently lives in the hot tier.
+  [[nodiscard]] bool is_hot(std::size_t i) const noexcept
+  {
+    return _slot[i] != NO_SLOT;
+  }
+  /// @brief Returns the number of indices in the hot tier.
+  [[nodiscard]] std::size_t hot_size() const noexcept { return _hot.size(); }
+  /// @brief Returns the sum of all weights.
+  [[nodiscard]] T get_total() const noexcept
+  {
+    return _hot_total + _cold.get().get_total();
+  }
+  /// @brief Returns the cold tier.
+  [[nodiscard]] const bucket<std::vector<T>> &get_cold() const noexcept
+  {
+    return _cold.get();
+  }
+
+  /**
+   * @brief Sets the weight of index `i`.
+   *
+   * O(1) for hot indices, one row sum for cold ones. Every call counts towards
+   * the update frequency of `i` and may end the current epoch.
+   */
+  void set(std::size_t i, T weight)
+  {
+    const std::uint32_t slot = _slot[i];
+    if (slot != NO_SLOT)
+    {
+      _hot_total += weight - _hot[slot];
+      _hot[slot] = weight;
+    }
+    else
+    {
+      _cold.values()[i] = weight;
+      _cold.get().update_sum_at_row(i / _cold.get().get_cols());
+    }
+
+    if (_hit_epoch[i] != _epoch)
+    {
+      _hit_epoch[i] = _epoch;
+      _hits[i] = 0;
+    }
+    if (++_hits[i] == _promote_threshold && slot == NO_SLOT)
+      _candidates.push_back(i);
+
+    if (++_updates_in_epoch == _epoch_length)
+      migrate();
+  }
+
+  /**
+   * @brief Returns the index where the running sum over both tiers (hot tier
+   * first) reaches `val`.
+   */
+  [[nodiscard]] std::size_t find_upper_bound(const T &val) const
+  {
+    // Exactly the hot total stays in the hot tier also for floating-point
+    // weights, since the cold bucket only accepts targets above 0.
+    if (val <= _hot_total)
+    {
+      T temp = static_cast<T>(0);
+      for (std::size_t slot = 0; slot < _hot.size(); slot++)
+      {
+        temp += _hot[slot];
+        if (temp >= val)
+          return _hot_index[slot];
+      }
+      // Only reachable through rounding: the last positive hot weight.
+      const std::size_t slot = detail::last_positive(_hot.data(), _hot.size());
+      if (slot < _hot.size())
+        return _hot_index[slot];
+    }
+    return _cold.get().find_upper_bound(val - _hot_total);
+  }
+
+  /**
+   * @brief Draws one index with probability proportional to its weight.
+   *
+   * @return Index, or NOT_FOUND if the total is not positive
+   */
+  template <std::uniform_random_bit_generator URBG>
+  [[nodiscard]] std::size_t sample(URBG &rng) const
+  {
+    const T total = get_total();
+    if (!(total > 0))
+      return NOT_FOUND;
+
+    return find_upper_bound(detail::draw_target(rng, total));
+  }
+
+  /**
+   * @brief Ends the current epoch: demotes hot indices that cooled down and
+   * promotes the cold indices that crossed the threshold.
+   *
+   * Called automatically every `epoch_length` updates.
+   */
+  void migrate()
+  {
+    for (std::size_t slot = _hot.size(); slot-- > 0;)
+    {
+      const std::size_t i = _hot_index[slot];
+      if (hits(i) < _promote_threshold / 2)
+        demote(slot);
+    }
+
+    std::sort(_candidates.begin(), _candidates.end(),
+              [&](std::size_t a, std::size_t b) { return hits(a) > hits(b); });
+    for (std::size_t i : _candidates)
+    {
+      if (_slot[i] != NO_SLOT)
+        continue;
+      if (_hot.size() == _hot_capacity)
+      {
+        auto coldest = std::min_element(
+            _hot_index.begin(), _hot_index.end(),
+            [&](std::size_t a, std::size_t b) { return hits(a) < hits(b); });
+        if (coldest == _hot_index.end() || hits(*coldest) >= hits(i))
+          break;
+        demote(static_cast<std::size_t>(coldest - _hot_index.begin()));
+      }
+      promote(i);
+    }
+
+    // Re-sum the hot tier exactly, dropping the rounding of the deltas.
+    _hot_total = std::accumulate(_hot.begin(), _hot.end(), static_cast<T>(0));
+    _candidates.clear();
+    _updates_in_epoch = 0;
+    _epoch++;
+  }
+
+private:
+  std::uint32_t hits(std::size_t i) const noexcept
+  {
+    return _hit_epoch[i] == _epoch ? _hits[i] : 0;
+  }
+
+  void promote(std::size_t i)
+  {
+    _slot[i] = static_cast<std::uint32_t>(_hot.size());
+    _hot.push_back(_cold.values()[i]);
+    _hot_index.push_back(i);
+    _cold.values()[i] = static_cast<T>(0);
+    _cold.get().update_sum_at_row(i / _cold.get().get_cols());
+  }
+
+  // Moves a hot slot back to the cold tier, filling the hole with the last
+  // slot so that the hot tier stays dense.
+  void demote(std::size_t slot)
+  {
+    const std::size_t i = _hot_index[slot];
+    _cold.values()[i] = _hot[slot];
+    _cold.get().update_sum_at_row(i / _cold.get().get_cols());
+    _slot[i] = NO_SLOT;
+
+    const std::size_t last = _hot.size() - 1;
+    if (slot != last)
+    {
+      _hot[slot] = _hot[last];
+      _hot_index[slot] = _hot_index[last];
+      _slot[_hot_index[slot]] = static_cast<std::uint32_t>(slot);
+    }
+    _hot.pop_back();
+    _hot_index.pop_back();
+  }
+};
+} // namespace bucketlib
@@ -2,6 +2,12 @@
 #include <doctest/doctest.h>
 
 #include <bucket/bucket.hpp>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <stdexcept>
 #include <vector>
 
 using bucketlib::bucket;
@@ -96,3 +102,499 @@ TEST_CASE("Basic functionality of bucket")
     CHECK(b.get_cumsums()[3] == doctest::Approx(5.4));
   }
 }
+
+TEST_CASE("Heavy-first in-row ordering")
+{
+  std::vector<double> data = {0.1, 0.5, 0.2, 0.9, 0.3, 0.4, 0.0, 0.0, 1.0};
+
+  bucket<std::vector<double>> b(3, 3, data);
+  b.set_heavy_first(true);
+  CHECK(b.is_heavy_first());
+
+  SUBCASE("Heaviest element of a row is found first")
+  {
+    CHECK(b.find_upper_bound(0.4) == 1);
+    CHECK(b.find_upper_bound(0.6) == 2);
+    CHECK(b.find_upper_bound(0.75) == 0);
+    CHECK(b.find_upper_bound(1.0) == 3);
+    CHECK(b.find_upper_bound(2.3) == 4);
+    CHECK(b.find_upper_bound(2.5) == 8);
+  }
+
+  SUBCASE("Order follows updates")
+  {
+    data[0] = 2.0;
+    b.update_sum_at_row(0);
+    b.refresh_cumsum();
+    CHECK(b.find_upper_bound(1.9) == 0);
+    CHECK(b.find_upper_bound(2.1) == 1);
+  }
+
+  SUBCASE("Same distribution as the natural layout")
+  {
+    bucket<std::vector<double>> natural(3, 3, data);
+    std::vector<double> mass(data.size(), 0.0);
+    std::vector<double> natural_mass(data.size(), 0.0);
+    const double total = b.get_cumsums().back();
+    const std::size_t steps = 10'000;
+    for (std::size_t i = 0; i < steps; i++)
+    {
+      double val = total * (static_cast<double>(i) + 0.5) / steps;
+      const std::size_t index = b.find_upper_bound(val);
+      const std::size_t expected = natural.find_upper_bound(val);
+      // The permutation only reorders elements within a row.
+      CHECK(index / 3 == expected / 3);
+      mass[index] += total / steps;
+      natural_mass[expected] += total / steps;
+    }
+    for (std::size_t i = 0; i < data.size(); i++)
+      CHECK(mass[i] == doctest::Approx(natural_mass[i]).epsilon(0.01));
+  }
+
+  SUBCASE("Disabling restores the natural scan")
+  {
+    b.set_heavy_first(false);
+    CHECK_FALSE(b.is_heavy_first());
+    CHECK(b.find_upper_bound(0.05) == 0);
+  }
+}
+
+TEST_CASE("Ragged final row")
+{
+  std::vector<double> data = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7};
+
+  bucket<std::vector<double>> b(3, 3, data);
+
+  CHECK(b.get_row_length(0) == 3);
+  CHECK(b.get_row_length(2) == 1);
+  CHECK(b.get_sums()[2] == doctest::Approx(0.7));
+  CHECK(b.get_cumsums()[3] == doctest::Approx(2.8));
+  CHECK(b.find_upper_bound(2.7) == 6);
+#ifdef ENABLE_CHECKS
+  CHECK_THROWS_AS((void)b.find_upper_bound(2.8 + 1e-9), std::runtime_error);
+#else
+  CHECK_FALSE(b.is_valid_index(b.find_upper_bound(2.8 + 1e-9)));
+#endif
+
+  SUBCASE("Heavy-first layout")
+  {
+    b.set_heavy_first(true);
+    CHECK(b.find_upper_bound(2.7) == 6);
+  }
+
+  SUBCASE("Automatic shape")
+  {
+    std::vector<double> large(1000, 1.0);
+    bucket<std::vector<double>> a(large);
+    CHECK(a.get_cols() % decltype(a)::SIMD_WIDTH == 0);
+    CHECK(a.get_rows() * a.get_cols() >= large.size());
+    CHECK((a.get_rows() - 1) * a.get_cols() < large.size());
+    CHECK(a.get_cumsums().back() == doctest::Approx(1000.0));
+    CHECK(a.find_upper_bound(999.5) == 999);
+  }
+}
+
+TEST_CASE("Lazy refresh")
+{
+  std::vector<double> data = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9};
+
+  bucket<std::vector<double>> b(3, 3, data);
+  b.set_lazy_refresh(true);
+  CHECK(b.is_lazy_refresh());
+
+  data[4] = 1.5; // row 1: 0.4 + 1.5 + 0.6
+  b.update_sum_at_row(1);
+  CHECK(b.get_total() == doctest::Approx(5.5));
+  CHECK(b.get_min_row_affected() == 1);
+
+  SUBCASE("Queries below the affected rows need no refresh")
+  {
+    CHECK(b.find_upper_bound(0.5) == 2);
+    CHECK(b.get_min_row_affected() == 1);
+  }
+
+  SUBCASE("Queries refresh only as far as needed")
+  {
+    CHECK(b.find_upper_bound(2.0) == 4);
+    CHECK(b.get_min_row_affected() == 2);
+    CHECK(b.get_cumsums()[2] == doctest::Approx(3.1));
+    CHECK(b.find_upper_bound(5.4) == 8);
+    CHECK(b.get_min_row_affected() == 3);
+    CHECK(b.get_cumsums()[3] == doctest::Approx(5.5));
+  }
+
+  SUBCASE("Updates are coalesced")
+  {
+    data[8] = 0.0;
+    b.update_sum_at_row(2);
+    data[0] = 0.0;
+    b.update_sum_at_row(0);
+    CHECK(b.get_total() == doctest::Approx(4.5));
+    CHECK(b.find_upper_bound(4.4) == 7);
+    CHECK(b.find_upper_bound(0.1) == 1);
+  }
+
+  SUBCASE("Explicit refresh and switching back")
+  {
+    b.refresh_cumsum();
+    CHECK(b.get_min_row_affected() == 3);
+    CHECK(b.get_cumsums()[2] == doctest::Approx(3.1));
+    CHECK(b.get_cumsums()[3] == doctest::Approx(5.5));
+
+    data[4] = 0.5;
+    b.update_sum_at_row(1);
+    b.set_lazy_refresh(false);
+    CHECK(b.get_cumsums()[3] == doctest::Approx(4.5));
+    CHECK(b.find_upper_bound(2.2) == 6);
+  }
+}
+
+TEST_CASE("Generic contiguous ranges")
+{
+  std::pmr::monotonic_buffer_resource pool;
+  std::pmr::vector<double> data({0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7}, &pool);
+
+  bucket<std::pmr::vector<double>> b(3, 3, data);
+  CHECK(b.get_total() == doctest::Approx(2.8));
+  CHECK(b.find_upper_bound(0.7) == 3);
+  CHECK(b.find_upper_bound(2.7) == 6);
+
+  data[6] = 0.0;
+  b.update_sum_at_row(2);
+  b.refresh_cumsum();
+  CHECK(b.get_total() == doctest::Approx(2.1));
+}
+
+TEST_CASE("Sampling")
+{
+  std::vector<double> data = {0.1, 0.0, 0.3, 0.4, 0.5, 0.6, 0.0, 0.8, 0.9};
+  const double total = 3.6;
+
+  bucket<std::vector<double>> b(3, 3, data);
+  std::mt19937 rng(42);
+
+  SUBCASE("Single samples follow the weights")
+  {
+    std::vector<std::size_t> counts(data.size(), 0);
+    const std::size_t n = 100'000;
+    for (std::size_t i = 0; i < n; i++)
+      counts[b.sample(rng)]++;
+    for (std::size_t i = 0; i < data.size(); i++)
+      CHECK(static_cast<double>(counts[i]) / n ==
+            doctest::Approx(data[i] / total).epsilon(0.05));
+    CHECK(counts[1] == 0);
+    CHECK(counts[6] == 0);
+  }
+
+  SUBCASE("Multinomial counts")
+  {
+    std::vector<double> mean(data.size(), 0.0);
+    const std::size_t k = 1000;
+    const std::size_t reps = 200;
+    for (std::size_t r = 0; r < reps; r++)
+    {
+      auto counts = b.sample_counts(k, rng);
+      REQUIRE(counts.size() == data.size());
+      CHECK(std::accumulate(counts.begin(), counts.end(), std::size_t{0}) ==
+            k);
+      CHECK(counts[1] == 0);
+      CHECK(counts[6] == 0);
+      for (std::size_t i = 0; i < data.size(); i++)
+        mean[i] += static_cast<double>(counts[i]) / reps;
+    }
+    for (std::size_t i = 0; i < data.size(); i++)
+      CHECK(mean[i] == doctest::Approx(k * data[i] / total).epsilon(0.02));
+  }
+
+  SUBCASE("Sorted index list")
+  {
+    auto indices = b.sample_indices(500, rng);
+    CHECK(indices.size() == 500);
+    CHECK(std::is_sorted(indices.begin(), indices.end()));
+    CHECK(indices.back() < data.size());
+  }
+
+  SUBCASE("Integral weights")
+  {
+    std::vector<int> ints = {0, 2, 0, 1, 0, 1};
+    bucket<std::vector<int>> bi(2, 3, ints);
+    std::vector<std::size_t> counts(ints.size(), 0);
+    for (std::size_t i = 0; i < 40'000; i++)
+      counts[bi.sample(rng)]++;
+    CHECK(counts[0] + counts[2] + counts[4] == 0);
+    CHECK(counts[1] / 40'000.0 == doctest::Approx(0.5).epsilon(0.05));
+    CHECK(bi.sample_counts(7, rng)[5] <= 7);
+  }
+}
+
+TEST_CASE("Float mirror of the cumulative sums")
+{
+  // Many tiny rows next to huge ones, so that whole runs of cumulative sums
+  // round to the same float.
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  std::vector<double> data(4096);
+  for (std::size_t i = 0; i < data.size(); i++)
+    data[i] = (i / 64) % 7 == 0 ? 1e9 * dist(rng) : 1e-3 * dist(rng);
+  std::vector<double> copy = data;
+
+  bucket<std::vector<double>> mirrored(256, 16, data);
+  bucket<std::vector<double>> plain(256, 16, copy);
+  mirrored.set_float_mirror(true);
+  CHECK(mirrored.is_float_mirror());
+
+  SUBCASE("Eager refresh") {}
+  SUBCASE("Lazy refresh")
+  {
+    mirrored.set_lazy_refresh(true);
+    plain.set_lazy_refresh(true);
+  }
+
+  for (std::size_t it = 0; it < 2000; it++)
+  {
+    const std::size_t i = rng() % data.size();
+    data[i] = copy[i] = (i / 64) % 7 == 0 ? 1e9 * dist(rng) : 1e-3 * dist(rng);
+    mirrored.update_sum_at_row(i / 16);
+    plain.update_sum_at_row(i / 16);
+    const std::size_t row = 1 + rng() % 255;
+    if (!mirrored.is_lazy_refresh() || it % 4 == 0)
+    {
+      mirrored.refresh_cumsum();
+      plain.refresh_cumsum();
+    }
+
+    // Values on and around row boundaries, and random ones.
+    const double boundary = plain.get_cumsums()[row];
+    for (double val : {boundary, std::nextafter(boundary, 0.0),
+                       std::nextafter(boundary, 1e300),
+                       dist(rng) * plain.get_total()})
+      if (val > 0 && val < plain.get_total())
+        REQUIRE(mirrored.find_upper_bound(val) == plain.find_upper_bound(val));
+  }
+
+  mirrored.set_float_mirror(false);
+  CHECK_FALSE(mirrored.is_float_mirror());
+}
+
+TEST_CASE("Drift monitor")
+{
+  // Mixed magnitudes make the subtracted differences round noticeably.
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  std::vector<double> data(4096);
+  for (double &x : data)
+    x = dist(rng) < 0.1 ? 1e6 * dist(rng) : dist(rng);
+
+  bucket<std::vector<double>> b(512, 8, data);
+  const double tolerance = 1e-13;
+  b.set_drift_tolerance(tolerance);
+  CHECK(b.is_drift_monitor());
+
+  SUBCASE("Eager refresh") {}
+  SUBCASE("Lazy refresh") { b.set_lazy_refresh(true); }
+
+  for (std::size_t it = 0; it < 20000; it++)
+  {
+    const std::size_t i = rng() % data.size();
+    data[i] = dist(rng) < 0.1 ? 1e6 * dist(rng) : dist(rng);
+    b.update_sum_at_row(i / 8);
+    if (!b.is_lazy_refresh() || it % 8 == 0)
+      b.refresh_cumsum();
+  }
+  b.refresh_cumsum();
+
+  // Every bound stays within tolerance, and so does the actual error.
+  double exact = 0.0;
+  const double limit = tolerance * b.get_total();
+  for (std::size_t row = 0; row < 512; row++)
+  {
+    for (std::size_t col = 0; col < 8; col++)
+      exact += data[row * 8 + col];
+    CHECK(b.get_drift_bound(row + 1) <= limit);
+    REQUIRE(std::abs(b.get_cumsums()[row + 1] - exact) <= limit);
+  }
+  CHECK(b.get_drift_resums() > 0);
+
+  // Row sums are re-summed on every update, so they carry no drift at all.
+  for (std::size_t row = 0; row < 512; row++)
+  {
+    long double row_exact = 0;
+    for (std::size_t col = 0; col < 8; col++)
+      row_exact += data[row * 8 + col];
+    REQUIRE(std::abs(b.get_sums()[row] - row_exact) <=
+            2 * std::numeric_limits<double>::epsilon() * row_exact);
+  }
+
+  b.set_drift_tolerance(0.0);
+  CHECK_FALSE(b.is_drift_monitor());
+  CHECK(b.get_drift_bound(10) == 0.0);
+}
+
+TEST_CASE("Incremental rebuild")
+{
+  std::mt19937 rng(9);
+  std::uniform_int_distribution<int> dist(0, 100);
+  std::vector<int> data(1000);
+  for (int &x : data)
+    x = dist(rng);
+
+  bucket<std::vector<int>> b(100, 10, data);
+  std::size_t rows = 100, cols = 10;
+
+  SUBCASE("Same shape") { b.begin_rebuild(3); }
+  SUBCASE("Reshape")
+  {
+    rows = 32;
+    cols = 32;
+    b.begin_rebuild(rows, cols, 2);
+  }
+  SUBCASE("Reshape with heavy-first")
+  {
+    b.set_heavy_first(true);
+    rows = 25;
+    cols = 40;
+    b.begin_rebuild(rows, cols);
+  }
+  SUBCASE("Reshape with lazy refresh")
+  {
+    b.set_lazy_refresh(true);
+    rows = 50;
+    cols = 20;
+    b.begin_rebuild(rows, cols);
+  }
+  CHECK(b.is_rebuilding());
+
+  std::size_t updates = 0;
+  while (b.is_rebuilding())
+  {
+    // The old shape keeps serving until the swap.
+    CHECK(b.get_cols() == 10);
+    const std::size_t i = rng() % data.size();
+    data[i] = dist(rng);
+    b.update_sum_at_row(i / b.get_cols());
+    b.refresh_cumsum();
+    updates++;
+  }
+  CHECK(updates <= 100);
+  REQUIRE(b.get_rows() == rows);
+  REQUIRE(b.get_cols() == cols);
+
+  bucket<std::vector<int>> fresh(rows, cols, data);
+  CHECK(b.get_sums() == fresh.get_sums());
+  CHECK(b.get_cumsums() == fresh.get_cumsums());
+  for (int val = 1; val <= fresh.get_total(); val += 7)
+  {
+    const std::size_t index = b.find_upper_bound(val);
+    REQUIRE(index < data.size());
+    CHECK(data[index] > 0);
+    if (!b.is_heavy_first())
+      CHECK(index == fresh.find_upper_bound(val));
+  }
+  CHECK(b.rebuild_step(1));
+}
+
+TEST_CASE("Fixed-width row kernels")
+{
+  std::mt19937 rng(21);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  // 20 full rows of 64 and a ragged last row of 37 elements.
+  std::vector<double> data(20 * 64 + 37);
+  for (double &x : data)
+    x = dist(rng);
+
+  bucket<std::vector<double>> b(21, 64, data);
+  CHECK(b.has_fixed_kernels());
+  CHECK_FALSE(bucket<std::vector<double>>(21, 65, data).has_fixed_kernels());
+
+  for (std::size_t it = 0; it < 200; it++)
+  {
+    const std::size_t i = rng() % data.size();
+    data[i] = dist(rng);
+    b.update_sum_at_row(i / 64);
+    b.refresh_cumsum();
+
+    // Same summation order as the generic loop, so sums are bit-identical.
+    for (std::size_t row = 0; row < 21; row++)
+    {
+      const auto first = data.begin() + row * 64;
+      const auto last = row < 20 ? first + 64 : data.end();
+      REQUIRE(b.get_sums()[row] == std::accumulate(first, last, 0.0));
+    }
+
+    const double val = dist(rng) * b.get_total();
+    const std::size_t index = b.find_upper_bound(val);
+    const std::size_t row = index / 64;
+    double running = b.get_cumsums()[row];
+    for (std::size_t j = row * 64; j < index; j++)
+      running += data[j];
+    CHECK(running < val);
+    CHECK(running + data[index] >= val);
+  }
+}
+
+TEST_CASE("Cyclic search from a start offset")
+{
+  std::mt19937 rng(33);
+  std::uniform_int_distribution<int> dist(0, 9);
+  std::vector<int> data(203);
+  for (int &x : data)
+    x = dist(rng) < 3 ? 0 : dist(rng);
+
+  bucket<std::vector<int>> b(21, 10, data);
+  SUBCASE("Natural layout") {}
+  SUBCASE("Heavy-first layout") { b.set_heavy_first(true); }
+  SUBCASE("Lazy refresh") { b.set_lazy_refresh(true); }
+
+  auto expected = [&](std::size_t start, int val)
+  {
+    int running = 0;
+    for (std::size_t k = 0; k < data.size(); k++)
+    {
+      const std::size_t j = (start + k) % data.size();
+      running += data[j];
+      if (running >= val)
+        return j;
+    }
+    return bucket<std::vector<int>>::NOT_FOUND;
+  };
+
+  for (std::size_t it = 0; it < 2000; it++)
+  {
+    const std::size_t i = rng() % data.size();
+    data[i] = dist(rng);
+    b.update_sum_at_row(i / 10);
+    if (!b.is_lazy_refresh())
+      b.refresh_cumsum();
+
+    const std::size_t start = rng() % data.size();
+    const int total = b.get_total();
+    for (int val : {1, total, 1 + static_cast<int>(rng() % total)})
+      REQUIRE(b.find_upper_bound_from(start, val) == expected(start, val));
+  }
+
+  // From index 0 it matches the plain search.
+  b.refresh_cumsum();
+  if (!b.is_heavy_first())
+    for (int val = 1; val <= b.get_total(); val++)
+      REQUIRE(b.find_upper_bound_from(0, val) == b.find_upper_bound(val));
+}
+
+TEST_CASE("Cyclic search with floating-point weights")
+{
+  std::vector<double> data(100, 0.5);
+  bucket<std::vector<double>> b(10, 10, data);
+
+  CHECK(b.find_upper_bound_from(95, 0.25) == 95);
+  CHECK(b.find_upper_bound_from(95, 3.0) == 0);
+  CHECK(b.find_upper_bound_from(95, 3.1) == 1);
+  CHECK(b.find_upper_bound_from(42, 1.0) == 43);
+  // 60 elements from 42 wrap around to index 1.
+  CHECK(b.find_upper_bound_from(42, 29.7) == 1);
+  // The whole total ends right before the start.
+  CHECK(b.find_upper_bound_from(42, 50.0) == 41);
+  CHECK(b.find_upper_bound_from(0, 50.0) == 99);
+  // The same from the first element of a row.
+  CHECK(b.find_upper_bound_from(40, 50.0) == 39);
+  CHECK(b.find_upper_bound_from(90, 50.0) == 89);
+  CHECK(b.find_upper_bound_from(10, 50.0) == 9);
+}
@@ -0,0 +1,111 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/batch.hpp>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using bucketlib::batch_lookup;
+using bucketlib::bucket;
+using bucketlib::find_upper_bound_batch;
+
+TEST_CASE_TEMPLATE("Batched lookups match find_upper_bound", T, double, int)
+{
+  std::mt19937 rng(13);
+  std::uniform_int_distribution<int> dist(0, 9);
+
+  // Buckets of different shapes, some lazy with pending updates and some
+  // heavy-first.
+  const std::size_t count = 200;
+  std::vector<std::vector<T>> data(count);
+  std::vector<std::unique_ptr<bucket<std::vector<T>>>> buckets;
+  for (std::size_t b = 0; b < count; b++)
+  {
+    data[b].resize(1 + rng() % 3000);
+    for (T &x : data[b])
+      x = static_cast<T>(dist(rng));
+    data[b][0] = 1; // keep every total positive
+    buckets.push_back(std::make_unique<bucket<std::vector<T>>>(data[b]));
+    if (b % 5 == 1)
+      buckets.back()->set_lazy_refresh(true);
+    if (b % 7 == 2)
+      buckets.back()->set_heavy_first(true);
+  }
+  for (std::size_t b = 1; b < count; b += 5)
+  {
+    data[b][0] = 5;
+    buckets[b]->update_sum_at_row(0);
+  }
+
+  std::vector<batch_lookup<bucket<std::vector<T>>>> lookups;
+  for (std::size_t i = 0; i < 5000; i++)
+  {
+    const auto &b = *buckets[rng() % count];
+    T val;
+    if constexpr (std::is_integral_v<T>)
+      val = static_cast<T>(1 + rng() % static_cast<unsigned>(b.get_total()));
+    else
+      val = std::uniform_real_distribution<double>(1e-9, 1.0)(rng) *
+            b.get_total() * (1 - 1e-12);
+    lookups.push_back({&b, val});
+  }
+
+  std::vector<std::size_t> out(lookups.size());
+  SUBCASE("Group of 16") { find_upper_bound_batch(lookups, out); }
+  SUBCASE("Group of 1") { find_upper_bound_batch<1>(lookups, out); }
+  SUBCASE("Group of 5") { find_upper_bound_batch<5>(lookups, out); }
+
+  for (std::size_t i = 0; i < lookups.size(); i++)
+    REQUIRE(out[i] == lookups[i].bucket->find_upper_bound(lookups[i].value));
+
+#ifdef ENABLE_CHECKS
+  std::vector<std::size_t> short_out(lookups.size() - 1);
+  CHECK_THROWS_AS(find_upper_bound_batch(lookups, short_out),
+                  std::runtime_error);
+#endif
+}
+
+TEST_CASE("Batched lookups follow the row search policy")
+{
+  using Blocked = bucket<std::vector<double>, bucketlib::policy::vector_storage,
+                         bucketlib::policy::blocked_row_search<4>>;
+  std::mt19937 rng(17);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+  const std::size_t count = 50;
+  std::vector<std::vector<double>> data(count);
+  std::vector<std::unique_ptr<Blocked>> buckets;
+  for (std::size_t b = 0; b < count; b++)
+  {
+    data[b].resize(1 + rng() % 2000);
+    for (double &x : data[b])
+      x = dist(rng);
+    buckets.push_back(std::make_unique<Blocked>(data[b]));
+  }
+
+  // Random targets, and targets right at element boundaries, where blocked
+  // and linear scans may round differently.
+  std::vector<batch_lookup<Blocked>> lookups;
+  for (std::size_t i = 0; i < 5000; i++)
+  {
+    const Blocked &b = *buckets[rng() % count];
+    double val = dist(rng) * b.get_total();
+    if (i % 2 == 0)
+    {
+      const std::size_t row = rng() % b.get_rows();
+      const std::size_t k = rng() % b.get_row_length(row);
+      val = b.get_cumsums()[row];
+      for (std::size_t j = 0; j <= k; j++)
+        val += b.get_container()[row * b.get_cols() + j];
+    }
+    if (val > 0 && val < b.get_total())
+      lookups.push_back({&b, val});
+  }
+
+  std::vector<std::size_t> out(lookups.size());
+  find_upper_bound_batch<8>(lookups, out);
+  for (std::size_t i = 0; i < lookups.size(); i++)
+    REQUIRE(out[i] == lookups[i].bucket->find_upper_bound(lookups[i].value));
+}
@@ -5,6 +5,8 @@
 #include <valarray>
 #include <list>
 #include <cstdint>
+#include <memory_resource>
+#include <new>
 
 using namespace bucketlib;
 
@@ -23,6 +25,36 @@ struct StructWithDataButNoRandomAccess {
   std::size_t size() const;
 };
 
+// Minimal over-aligned allocator following the usual `alignment` convention.
+template <typename T, std::size_t Align>
+struct aligned_allocator {
+  using value_type = T;
+  static constexpr std::size_t alignment = Align;
+  template <typename U> struct rebind { using other = aligned_allocator<U, Align>; };
+  aligned_allocator() = default;
+  template <typename U> aligned_allocator(const aligned_allocator<U, Align>&) {}
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+  }
+  void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t{Align}); }
+  bool operator==(const aligned_allocator&) const = default;
+};
+
+// Custom contiguous container with inline storage.
+template <typename T, std::size_t N>
+struct small_vector {
+  using value_type = T;
+  T buffer[N];
+  std::size_t count = 0;
+  T* begin() { return buffer; }
+  T* end() { return buffer + count; }
+  const T* begin() const { return buffer; }
+  const T* end() const { return buffer + count; }
+  T* data() { return buffer; }
+  const T* data() const { return buffer; }
+  std::size_t size() const { return count; }
+};
+
 
 // CONSTRUCTION
 // ----------------------------------------------
@@ -63,6 +95,19 @@ static_assert(std::is_constructible_v<
     std::size_t, std::size_t, const std::array<int, 10>&
 >);
 
+static_assert(std::is_constructible_v<
+    bucket<std::vector<double, aligned_allocator<double, 64>>>,
+    std::size_t, std::size_t, const std::vector<double, aligned_allocator<double, 64>>&
+>);
+static_assert(std::is_constructible_v<
+    bucket<std::pmr::vector<double>>,
+    std::size_t, std::size_t, const std::pmr::vector<double>&
+>);
+static_assert(std::is_constructible_v<
+    bucket<small_vector<float, 16>>,
+    std::size_t, std::size_t, const small_vector<float, 16>&
+>);
+
 // More tests about the numeric types
 
 
@@ -82,9 +127,12 @@ static_assert(RandomAccessContainer<std::vector<double>>);
 
 static_assert(RandomAccessContainer<std::array<float, 4>>);
 static_assert(RandomAccessContainer<std::span<double>>); // C++20
-static_assert(!RandomAccessContainer<std::valarray<double>>); // no iterators
+static_assert(RandomAccessContainer<std::valarray<double>>); // std::begin/std::end
 static_assert(!RandomAccessContainer<std::list<double>>);     // not random-access
 static_assert(!RandomAccessContainer<StructWithDataButNoRandomAccess>);
+static_assert(RandomAccessContainer<std::vector<double, aligned_allocator<double, 64>>>);
+static_assert(RandomAccessContainer<std::pmr::vector<double>>);
+static_assert(RandomAccessContainer<small_vector<int, 8>>);
 
 // ----------------------------------------------
 // NRAContainer: combination
@@ -99,6 +147,14 @@ static_assert(!NRAContainer<std::vector<char16_t>>);
 static_assert(!NRAContainer<std::vector<char32_t>>);
 static_assert(!NRAContainer<std::vector<char8_t>>);
 static_assert(!NRAContainer<std::vector<BadType>>);
+static_assert(NRAContainer<std::pmr::vector<double>>);
+static_assert(NRAContainer<small_vector<float, 16>>);
+
+// ----------------------------------------------
+// Alignment detection
+static_assert(container_alignment_v<std::vector<double>> == alignof(double));
+static_assert(container_alignment_v<std::vector<double, aligned_allocator<double, 64>>> == 64);
+static_assert(bucket<std::vector<float, aligned_allocator<float, 32>>>::ALIGNMENT == 32);
 
 
 
@@ -0,0 +1,94 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/concurrent.hpp>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+using bucketlib::concurrent_bucket;
+
+TEST_CASE("Concurrent bucket, single thread")
+{
+  std::vector<double> weights(10000, 0.0);
+  concurrent_bucket<double> b(weights);
+  std::mt19937 rng(1);
+
+  CHECK(b.sample(rng) == concurrent_bucket<double>::NOT_FOUND);
+
+  b.set(17, 1.0);
+  b.set(5000, 2.0);
+  b.add(9999, 1.0);
+  CHECK(b.get_total() == doctest::Approx(4.0));
+  CHECK(b.get(5000) == 2.0);
+
+  std::vector<int> counts(weights.size(), 0);
+  for (int i = 0; i < 40000; i++)
+    counts[b.sample(rng)]++;
+  CHECK(counts[17] + counts[5000] + counts[9999] == 40000);
+  CHECK(counts[5000] / 40000.0 == doctest::Approx(0.5).epsilon(0.05));
+
+  // Quiescent lookups are exact.
+  CHECK(b.find_upper_bound(0.5) == 17);
+  CHECK(b.find_upper_bound(1.5) == 5000);
+  CHECK(b.find_upper_bound(3.5) == 9999);
+}
+
+TEST_CASE("Concurrent bucket resolves stale sums within one block")
+{
+  // A target past the total stands in for sums that lag behind the weights.
+  std::vector<double> weights(10000, 0.0);
+  concurrent_bucket<double> b(weights);
+  const std::size_t NOT_FOUND = concurrent_bucket<double>::NOT_FOUND;
+  b.set(17, 1.0);
+  CHECK(b.find_upper_bound(5.0) == NOT_FOUND);
+
+  // A positive weight in another row of the last block is used instead.
+  const std::size_t near = (b.get_rows() - 2) * b.get_cols();
+  b.set(near, 1.0);
+  CHECK(b.find_upper_bound(5.0) == near);
+}
+
+TEST_CASE("Concurrent bucket, many writers and samplers")
+{
+  std::vector<long> weights(50000, 1);
+  concurrent_bucket<long> b(weights);
+  const std::size_t writers = 4, samplers = 4, ops = 50000;
+
+  std::atomic<bool> invalid{false};
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < writers; t++)
+    threads.emplace_back(
+        [&, t]
+        {
+          std::mt19937 rng(t);
+          for (std::size_t k = 0; k < ops; k++)
+          {
+            const std::size_t i = rng() % weights.size();
+            if (k % 2 == 0)
+              b.set(i, static_cast<long>(rng() % 4));
+            else
+              b.add(i, 1);
+          }
+        });
+  for (std::size_t t = 0; t < samplers; t++)
+    threads.emplace_back(
+        [&, t]
+        {
+          std::mt19937 rng(100 + t);
+          for (std::size_t k = 0; k < ops; k++)
+          {
+            const std::size_t i = b.sample(rng);
+            if (i >= weights.size())
+              invalid = true;
+          }
+        });
+  for (std::thread &thread : threads)
+    thread.join();
+
+  CHECK_FALSE(invalid);
+  // Integer deltas are exact: the sums match the weights once quiescent.
+  CHECK(b.get_total() == std::accumulate(weights.begin(), weights.end(), 0L));
+}
@@ -0,0 +1,206 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/delay_ssa.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using bucketlib::calendar_queue;
+using bucketlib::delay_ssa;
+
+TEST_CASE("Calendar queue")
+{
+  calendar_queue q(1000, 0.5);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> near(0.0, 20.0);
+
+  // Random times, a far future event (many years ahead) and ties.
+  std::vector<std::pair<double, std::uint32_t>> events;
+  for (std::uint32_t i = 0; i < 900; i++)
+    events.emplace_back(near(rng), i);
+  events.emplace_back(1e6, 900);
+  for (std::uint32_t i = 901; i < 910; i++)
+    events.emplace_back(7.25, i);
+  for (const auto &[time, id] : events)
+    q.push(time, id);
+  CHECK(q.size() == events.size());
+  std::stable_sort(events.begin(), events.end(),
+                   [](const auto &a, const auto &b)
+                   { return a.first < b.first; });
+  // Pops interleaved with pushes behind the current minimum.
+  const calendar_queue &view = q;
+  std::size_t k = 0;
+  for (; k < 450; k++)
+  {
+    CHECK(view.top_time() == events[k].first);
+    CHECK(q.pop() == events[k]);
+  }
+  q.push(0.1, 5000);
+  CHECK(view.top_time() == 0.1);
+  CHECK(q.pop() == std::pair<double, std::uint32_t>(0.1, 5000));
+  for (; k < events.size(); k++)
+    CHECK(q.pop() == events[k]);
+  CHECK(q.empty());
+
+  calendar_queue small(4, 1.0);
+  for (std::uint32_t i = 0; i < 4; i++)
+    small.push(i, i);
+  CHECK_THROWS_AS(small.push(5.0, 5), std::runtime_error);
+  small.pop();
+  small.push(5.0, 5);
+  CHECK(small.size() == 4);
+  CHECK_THROWS_AS(calendar_queue(10, 0.0), std::runtime_error);
+}
+
+TEST_CASE("Delay SSA completions follow their firings")
+{
+  // One reaction at rate 5; every firing completes 2.0 later.
+  delay_ssa<double> ssa(std::vector<double>{5.0}, 1000, 0.2);
+  std::mt19937 rng(11);
+  std::vector<double> fired;
+  std::vector<double> completed;
+  ssa.run_until(
+      200.0, rng,
+      [&](std::size_t r)
+      {
+        CHECK(r == 0);
+        fired.push_back(ssa.get_time());
+        ssa.schedule(2.0, static_cast<std::uint32_t>(fired.size() - 1));
+      },
+      [&](std::uint32_t id)
+      {
+        CHECK(ssa.get_time() == doctest::Approx(fired[id] + 2.0));
+        completed.push_back(ssa.get_time());
+      });
+
+  CHECK(ssa.get_time() == 200.0);
+  CHECK(std::is_sorted(fired.begin(), fired.end()));
+  CHECK(std::is_sorted(completed.begin(), completed.end()));
+  const auto expected =
+      std::count_if(fired.begin(), fired.end(),
+                    [](double t) { return t + 2.0 <= 200.0; });
+  CHECK(completed.size() == static_cast<std::size_t>(expected));
+  CHECK(ssa.get_completed() == completed.size());
+  CHECK(ssa.pending() == fired.size() - completed.size());
+  // Poisson(1000) firings.
+  CHECK(std::abs(static_cast<double>(fired.size()) - 1000.0) < 5 * 32);
+}
+
+TEST_CASE("Delay SSA with delayed production")
+{
+  // Transcription at rate k produces an mRNA tau later. Each mRNA decays at
+  // rate g. The steady-state mean is k / g.
+  const double k = 20.0, g = 2.0, tau = 1.5;
+  std::vector<double> propensities(2000, 0.0);
+  propensities[0] = k;
+  delay_ssa<double> ssa(propensities, 4096, 0.05);
+  std::mt19937 rng(5);
+
+  long m = 0;
+  double area = 0, last = 0;
+  auto account = [&] { area += m * (ssa.get_time() - last); };
+  auto fire = [&](std::size_t r)
+  {
+    account();
+    if (r == 0)
+      ssa.schedule(tau, 0);
+    else
+    {
+      CHECK(r == 1999);
+      m--;
+      ssa.set_propensity(1999, g * m);
+    }
+    last = ssa.get_time();
+  };
+  auto complete = [&](std::uint32_t)
+  {
+    account();
+    m++;
+    ssa.set_propensity(1999, g * m);
+    last = ssa.get_time();
+  };
+
+  ssa.run_until(20.0, rng, fire, complete);
+  area = 0;
+  last = ssa.get_time();
+  ssa.run_until(2020.0, rng, fire, complete);
+  account();
+  CHECK(m >= 0);
+  CHECK(area / 2000.0 == doctest::Approx(k / g).epsilon(0.05));
+}
+
+TEST_CASE("Delay SSA copies run independently")
+{
+  delay_ssa<double> ssa(std::vector<double>{1.0, 2.0, 3.0}, 100, 0.1);
+  ssa.set_propensity(2, 0.0);
+  ssa.schedule(0.5, 7);
+
+  delay_ssa<double> copy = ssa;
+  ssa.set_propensity(0, 0.0);
+  ssa.set_propensity(1, 0.0);
+  CHECK(copy.get_propensity(1) == 2.0);
+
+  // The copy draws from its own propensities, which still include 0 and 1.
+  std::mt19937 rng(4);
+  std::vector<std::size_t> fired;
+  copy.run_until(
+      10.0, rng, [&](std::size_t r) { fired.push_back(r); },
+      [](std::uint32_t) {});
+  CHECK_FALSE(fired.empty());
+  for (std::size_t r : fired)
+    CHECK(r < 2);
+  CHECK(copy.get_completed() == 1);
+
+  delay_ssa<double> moved = std::move(copy);
+  CHECK(moved.get_time() == 10.0);
+  CHECK(moved.step(rng, [](std::size_t) {}, [](std::uint32_t) {}));
+  // The original only holds its pending completion.
+  CHECK(ssa.pending() == 1);
+  CHECK(ssa.step(
+      rng, [](std::size_t) { FAIL("no reaction can fire"); },
+      [](std::uint32_t) {}));
+  CHECK(ssa.pending() == 0);
+}
+
+TEST_CASE("Delay SSA batch window")
+{
+  delay_ssa<double> ssa(std::vector<double>(10, 0.0), 100, 0.1);
+  std::mt19937 rng(1);
+  auto fire = [](std::size_t) { FAIL("no reaction can fire"); };
+  std::size_t completed = 0;
+  auto complete = [&](std::uint32_t) { completed++; };
+
+  // Same-time completions form one step even without a window.
+  for (std::uint32_t i = 0; i < 5; i++)
+    ssa.schedule(1.0, i);
+  for (std::uint32_t i = 0; i < 5; i++)
+    ssa.schedule(1.0 + 0.1 * (i + 1), 5 + i);
+  CHECK(ssa.step(rng, fire, complete));
+  CHECK(completed == 5);
+  CHECK(ssa.get_time() == 1.0);
+
+  ssa.set_batch_window(0.25);
+  CHECK(ssa.step(rng, fire, complete));
+  CHECK(completed == 8);
+  CHECK(ssa.get_time() == doctest::Approx(1.3));
+
+  CHECK(ssa.run_until(1.45, rng, fire, complete) == 1);
+  CHECK(completed == 9);
+  CHECK(ssa.get_time() == 1.45);
+  CHECK(ssa.step(rng, fire, complete));
+  CHECK_FALSE(ssa.step(rng, fire, complete));
+  CHECK(completed == 10);
+
+  // A propensity set by a completion applies to the next draw.
+  ssa.schedule(0.5, 0);
+  std::size_t fired = 0;
+  CHECK(ssa.step(rng, fire, [&](std::uint32_t)
+                 { ssa.set_propensity(7, 1.0); }));
+  CHECK(ssa.step(rng, [&](std::size_t r) { fired += r == 7; }, complete));
+  CHECK(fired == 1);
+  CHECK(ssa.get_fired() == 1);
+}
@@ -0,0 +1,132 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/loader.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace bucketlib;
+
+namespace
+{
+template <typename Weights>
+concept makes_bucket = requires(Weights &&weights) {
+  std::forward<Weights>(weights).make_bucket();
+};
+
+std::string temp_path(const std::string &name)
+{
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+template <typename T>
+void write_raw(const std::string &path, const std::vector<T> &values)
+{
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+template <typename T>
+void write_npy(const std::string &path, const std::vector<T> &values,
+               const std::string &descr)
+{
+  std::string header = "{'descr': '" + descr +
+                       "', 'fortran_order': False, 'shape': (" +
+                       std::to_string(values.size()) + ",), }";
+  while ((10 + header.size() + 1) % 64 != 0)
+    header += ' ';
+  header += '\n';
+
+  std::ofstream out(path, std::ios::binary);
+  out.write("\x93NUMPY\x01\x00", 8);
+  const char length[2] = {static_cast<char>(header.size() & 0xff),
+                          static_cast<char>(header.size() >> 8)};
+  out.write(length, 2);
+  out.write(header.data(), static_cast<std::streamsize>(header.size()));
+  out.write(reinterpret_cast<const char *>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+} // namespace
+
+TEST_CASE("Loading weights")
+{
+  std::vector<double> values(100'003);
+  for (std::size_t i = 0; i < values.size(); i++)
+    values[i] = static_cast<double>(i % 97) * 0.25;
+  bucket<std::vector<double>> reference(values);
+
+  const std::string raw = temp_path("bucket_test_loader.bin");
+  const std::string npy = temp_path("bucket_test_loader.npy");
+  write_raw(raw, values);
+  write_npy(npy, values, "<f8");
+
+  load_options options;
+  SUBCASE("Single thread") {}
+  SUBCASE("Several threads and small chunks")
+  {
+    options.threads = 4;
+    options.chunk_bytes = 10'000;
+  }
+  SUBCASE("Direct I/O")
+  {
+    options.threads = 3;
+    options.direct_io = true;
+  }
+
+  for (const auto &loaded : {load_raw<double>(raw, 0, options),
+                             load_npy<double>(npy, 0, options)})
+  {
+    REQUIRE(loaded.values.size() == values.size());
+    CHECK(std::equal(values.begin(), values.end(), loaded.values.begin()));
+    CHECK(loaded.rows == reference.get_rows());
+    CHECK(loaded.cols == reference.get_cols());
+    CHECK(loaded.row_sums == reference.get_sums());
+  }
+
+  auto loaded = load_npy<double>(npy, 128, options);
+  auto b = loaded.make_bucket();
+  CHECK(b.get_cols() == 128);
+  CHECK(b.get_total() == doctest::Approx(reference.get_total()));
+  CHECK(b.find_upper_bound(1000.0) == reference.find_upper_bound(1000.0));
+  // The row sums are copied, so a second bucket is complete as well.
+  auto again = loaded.make_bucket();
+  CHECK(again.get_sums() == b.get_sums());
+  // A bucket over a temporary would dangle.
+  static_assert(makes_bucket<loaded_weights<double> &>);
+  static_assert(!makes_bucket<loaded_weights<double>>);
+
+  std::filesystem::remove(raw);
+  std::filesystem::remove(npy);
+}
+
+TEST_CASE("Loader errors")
+{
+  const std::string npy = temp_path("bucket_test_loader_errors.npy");
+  write_npy(npy, std::vector<float>{1.0f, 2.0f}, "<f4");
+
+  CHECK(load_npy<float>(npy).values.size() == 2);
+  CHECK_THROWS_AS((void)load_npy<double>(npy), std::runtime_error);
+  CHECK_THROWS_AS((void)load_raw<double>(temp_path("bucket_missing.bin")),
+                  std::runtime_error);
+
+  std::filesystem::remove(npy);
+}
+
+TEST_CASE("Big-endian .npy files")
+{
+  const std::string npy = temp_path("bucket_test_loader_be.npy");
+  std::vector<std::uint32_t> swapped = {0x01000000, 0x02000000, 0x03000000};
+  write_npy(npy, swapped, ">u4");
+
+  auto loaded = load_npy<std::uint32_t>(npy);
+  CHECK(loaded.values[0] == 1);
+  CHECK(loaded.values[2] == 3);
+  CHECK(loaded.row_sums[0] == 6);
+
+  std::filesystem::remove(npy);
+}
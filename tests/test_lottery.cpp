@@ -0,0 +1,79 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/lottery.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+using bucketlib::lottery_scheduler;
+
+TEST_CASE("Lottery scheduler")
+{
+  lottery_scheduler<int> s(1000);
+  std::mt19937 rng(7);
+
+  CHECK(s.pick(rng) == lottery_scheduler<int>::NOT_FOUND);
+
+  // Queues 10, 500 and 999 hold 1 : 2 : 1 tickets.
+  s.set_tickets(10, 5);
+  s.add_tickets(500, 10);
+  s.add_tickets(999, 5);
+  std::vector<int> counts(1000, 0);
+  for (int i = 0; i < 40000; i++)
+    counts[s.pick(rng)]++;
+  CHECK(s.get_total() == 20);
+  CHECK(counts[10] + counts[500] + counts[999] == 40000);
+  CHECK(counts[500] / 40000.0 == doctest::Approx(0.5).epsilon(0.05));
+  CHECK(counts[10] / 40000.0 == doctest::Approx(0.25).epsilon(0.05));
+
+  // Every pick sees all earlier updates.
+  s.set_tickets(10, 0);
+  s.set_tickets(500, 0);
+  s.set_tickets(999, 0);
+  s.add_tickets(123, 1);
+  CHECK(s.pick(rng) == 123);
+
+  // A submitted buffer keeps its capacity for the next batch.
+  std::vector<lottery_scheduler<int>::update> updates;
+  updates.reserve(64);
+  updates.emplace_back(123, -1);
+  updates.emplace_back(7, 2);
+  s.submit(updates);
+  CHECK(updates.empty());
+  CHECK(updates.capacity() >= 64);
+  CHECK(s.pick(rng) == 7);
+}
+
+TEST_CASE("Lottery scheduler with concurrent enqueuers")
+{
+  lottery_scheduler<long> s(4096);
+  const std::size_t threads = 4, per_thread = 20000;
+
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; t++)
+    workers.emplace_back(
+        [&, t]
+        {
+          lottery_scheduler<long>::batch b(s, 64);
+          for (std::size_t i = 0; i < per_thread; i++)
+            b.add((t * 7919 + i * 31) % s.size(), 1);
+        });
+
+  // The scheduler thread keeps picking while the enqueuers run.
+  std::mt19937 rng(11);
+  for (int i = 0; i < 10000; i++)
+  {
+    const std::size_t q = s.pick(rng);
+    CHECK((q == lottery_scheduler<long>::NOT_FOUND || s.get_tickets(q) > 0));
+  }
+  for (std::thread &w : workers)
+    w.join();
+
+  s.refresh();
+  CHECK(s.get_total() == static_cast<long>(threads * per_thread));
+  long sum = 0;
+  for (std::size_t q = 0; q < s.size(); q++)
+    sum += s.get_tickets(q);
+  CHECK(sum == s.get_total());
+}
@@ -0,0 +1,99 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/markov_bank.hpp>
+#include <random>
+#include <tuple>
+#include <vector>
+
+using bucketlib::markov_bank;
+using state = markov_bank<double>::state_type;
+
+TEST_CASE("Markov bank")
+{
+  // State 0 fans out to 1000 states, state 1 goes to 2 or 3, 2 and 3 go back
+  // to 0, state 4 is absorbing.
+  std::vector<std::tuple<state, state, double>> edges;
+  for (state to = 0; to < 1000; to++)
+    edges.emplace_back(0, to, to == 7 ? 1000.0 : 1.0);
+  edges.emplace_back(1, 3, 3.0);
+  edges.emplace_back(1, 2, 1.0);
+  edges.emplace_back(2, 0, 1.0);
+  edges.emplace_back(3, 0, 1.0);
+  auto bank = markov_bank<double>::from_transitions(1000, edges);
+
+  CHECK(bank.states() == 1000);
+  CHECK(bank.degree(0) == 1000);
+  CHECK(bank.degree(4) == 0);
+  CHECK(bank.get_total(0) == doctest::Approx(1999.0));
+  CHECK(bank.find_transition(1, 3) == 1);
+  CHECK(bank.find_transition(1, 4) == markov_bank<double>::NOT_FOUND);
+
+  std::mt19937 rng(3);
+  CHECK(bank.step(4, rng) == 4);
+
+  std::size_t to7 = 0, to3 = 0;
+  for (int i = 0; i < 20000; i++)
+  {
+    to7 += bank.step(0, rng) == 7;
+    to3 += bank.step(1, rng) == 3;
+  }
+  CHECK(to7 / 20000.0 == doctest::Approx(1000.0 / 1999.0).epsilon(0.03));
+  CHECK(to3 / 20000.0 == doctest::Approx(0.75).epsilon(0.03));
+
+  // A local edit only changes its own state.
+  bank.set_weight(0, bank.find_transition(0, 7), 0.0);
+  CHECK(bank.get_total(0) == doctest::Approx(999.0));
+  CHECK(bank.get_total(1) == doctest::Approx(4.0));
+  for (int i = 0; i < 2000; i++)
+    CHECK(bank.step(0, rng) != 7);
+
+  bank.set_weight(1, bank.find_transition(1, 2), 0.0);
+  CHECK(bank.step(1, rng) == 3);
+}
+
+TEST_CASE("Markov bank batched stepping")
+{
+  // A ring where every state moves 1 or 2 ahead with integer weights 1 : 3.
+  const state n = 500;
+  std::vector<std::size_t> offsets(n + 1);
+  std::vector<state> targets;
+  std::vector<int> weights;
+  for (state s = 0; s < n; s++)
+  {
+    offsets[s] = targets.size();
+    targets.push_back((s + 1) % n);
+    weights.push_back(1);
+    targets.push_back((s + 2) % n);
+    weights.push_back(3);
+  }
+  offsets[n] = targets.size();
+  markov_bank<int> bank(offsets, targets, weights);
+
+  std::vector<state> walkers(10000);
+  for (std::size_t w = 0; w < walkers.size(); w++)
+    walkers[w] = static_cast<state>(w % 7);
+  const std::vector<state> before = walkers;
+
+  std::mt19937 rng(5);
+  bank.step_many(walkers, rng);
+  std::size_t two = 0;
+  for (std::size_t w = 0; w < walkers.size(); w++)
+  {
+    const state moved = (walkers[w] + n - before[w]) % n;
+    REQUIRE((moved == 1 || moved == 2));
+    two += moved == 2;
+  }
+  CHECK(two / 10000.0 == doctest::Approx(0.75).epsilon(0.05));
+
+  // A second call starts from clean groups.
+  const std::vector<state> middle = walkers;
+  bank.step_many(walkers, rng);
+  for (std::size_t w = 0; w < walkers.size(); w++)
+  {
+    const state moved = (walkers[w] + n - middle[w]) % n;
+    REQUIRE((moved == 1 || moved == 2));
+  }
+
+  CHECK_THROWS_AS(markov_bank<int>({0, 1}, {5}, {1}), std::runtime_error);
+}
@@ -0,0 +1,95 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/bucket.hpp>
+#include <bucket/philox.hpp>
+#include <random>
+#include <vector>
+
+using bucketlib::bucket;
+using bucketlib::philox4x32;
+
+TEST_CASE("Philox4x32-10 known answers")
+{
+  using counter = philox4x32::counter_type;
+  CHECK(philox4x32::generate({0, 0, 0, 0}, {0, 0}) ==
+        counter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+  CHECK(philox4x32::generate({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                             {0xffffffff, 0xffffffff}) ==
+        counter{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+  CHECK(philox4x32::generate({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                             {0xa4093822, 0x299f31d0}) ==
+        counter{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+}
+
+TEST_CASE("Philox as a uniform random bit generator")
+{
+  static_assert(std::uniform_random_bit_generator<philox4x32>);
+
+  philox4x32 a(3), b(3);
+  b.discard(6);
+  for (int i = 0; i < 6; i++)
+    a();
+  for (int i = 0; i < 16; i++)
+    CHECK(a() == b());
+
+  philox4x32 c(3, 1);
+  a = philox4x32(3);
+  a.discard(4);
+  CHECK(a() == c());
+}
+
+TEST_CASE("Uniform batches match single draws")
+{
+  std::vector<double> batch(101);
+  philox4x32::fill_uniform<double>(11, 5, batch);
+  for (std::size_t j = 0; j < batch.size(); j++)
+  {
+    CHECK(batch[j] == philox4x32::to_unit<double>(philox4x32::bits(11, 5 + j)));
+    CHECK(batch[j] > 0.0);
+    CHECK(batch[j] < 1.0);
+  }
+}
+
+TEST_CASE("Reproducible sampling independent of the split")
+{
+  std::vector<double> data(1000);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (auto &x : data)
+    x = dist(rng);
+  bucket<std::vector<double>> b(data);
+
+  const std::size_t n = 10'000;
+  std::vector<std::size_t> whole(n);
+  b.sample_many(whole, 42, 0);
+
+  std::vector<std::size_t> pieces(n);
+  std::span<std::size_t> all(pieces);
+  b.sample_many(all.subspan(0, 333), 42, 0);
+  b.sample_many(all.subspan(333, 1), 42, 333);
+  b.sample_many(all.subspan(334), 42, 334);
+  CHECK(whole == pieces);
+
+  std::vector<std::size_t> other(n);
+  b.sample_many(other, 43, 0);
+  CHECK(whole != other);
+
+  double mean_weight = 0.0;
+  for (std::size_t index : whole)
+  {
+    REQUIRE(index < data.size());
+    mean_weight += data[index] / n;
+  }
+  // Size-biased sampling of U(0, 1) weights has mean E[w^2] / E[w] = 2 / 3.
+  CHECK(mean_weight == doctest::Approx(2.0 / 3.0).epsilon(0.02));
+
+  SUBCASE("Generic engines")
+  {
+    philox4x32 engine(42);
+    std::vector<std::size_t> out(100);
+    b.sample_many(out, engine);
+    for (std::size_t index : out)
+      CHECK(index < data.size());
+  }
+}
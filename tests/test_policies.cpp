@@ -0,0 +1,203 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/bucket.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using bucketlib::bucket;
+namespace policy = bucketlib::policy;
+
+using Data = std::vector<int>;
+using Default = bucket<Data>;
+
+template <typename B>
+concept LazyConfigurable = requires(B &b) { b.set_lazy_refresh(true); };
+template <typename B>
+concept HeavyFirstConfigurable = requires(B &b) { b.set_heavy_first(true); };
+
+TEST_CASE_TEMPLATE(
+    "Policy combinations agree with the default bucket", B,
+    bucket<Data, policy::aligned_storage>,
+    bucket<Data, policy::vector_storage, policy::blocked_row_search<>>,
+    bucket<Data, policy::vector_storage, policy::blocked_row_search<4>,
+           policy::branchless_top_search, policy::eager_refresh>,
+    bucket<Data, policy::aligned_storage, policy::linear_row_search,
+           policy::linear_top_search, policy::lazy_refresh>,
+    bucket<Data, policy::vector_storage, policy::heavy_first_row_search,
+           policy::binary_top_search, policy::lazy_refresh,
+           policy::counting_stats>)
+{
+  std::mt19937 rng(17);
+  std::uniform_int_distribution<int> dist(0, 50);
+  Data data(997);
+  for (int &x : data)
+    x = dist(rng);
+
+  Default reference(40, 25, data);
+  B b(40, 25, data);
+
+  for (std::size_t it = 0; it < 500; it++)
+  {
+    const std::size_t i = rng() % data.size();
+    data[i] = dist(rng);
+    reference.update_sum_at_row(i / 25);
+    b.update_sum_at_row(i / 25);
+    reference.refresh_cumsum();
+    // Lazy buckets are queried with pending updates most of the time.
+    if (!b.is_lazy_refresh() || it % 3 == 0)
+      b.refresh_cumsum();
+
+    REQUIRE(b.get_total() == reference.get_total());
+    const int val = 1 + static_cast<int>(rng() % reference.get_total());
+    const std::size_t index = b.find_upper_bound(val);
+    const std::size_t expected = reference.find_upper_bound(val);
+    if (b.is_heavy_first())
+    {
+      // Same row, any element of it with positive weight.
+      CHECK(index / 25 == expected / 25);
+      CHECK(data[index] > 0);
+    }
+    else
+      REQUIRE(index == expected);
+  }
+}
+
+TEST_CASE_TEMPLATE(
+    "Floating-point policy combinations stay within rounding", B,
+    bucket<std::vector<double>, policy::vector_storage,
+           policy::blocked_row_search<4>, policy::branchless_top_search,
+           policy::eager_refresh>,
+    bucket<std::vector<double>, policy::aligned_storage,
+           policy::blocked_row_search<>, policy::linear_top_search,
+           policy::lazy_refresh>)
+{
+  std::mt19937 rng(23);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  std::vector<double> data(997);
+  for (double &x : data)
+    x = dist(rng);
+
+  B b(40, 25, data);
+  // Whether `index` holds `val`, up to the rounding of the sums.
+  auto holds = [&](std::size_t index, double val)
+  {
+    if (index >= data.size() || !(data[index] > 0))
+      return false;
+    long double before = 0;
+    for (std::size_t i = 0; i < index; i++)
+      before += data[i];
+    const long double tolerance = 1e-12L * b.get_total();
+    return before - tolerance <= val && val <= before + data[index] + tolerance;
+  };
+
+  for (std::size_t it = 0; it < 300; it++)
+  {
+    const std::size_t i = rng() % data.size();
+    data[i] = it % 7 == 0 ? 0.0 : dist(rng);
+    b.update_sum_at_row(i / 25);
+    if (!b.is_lazy_refresh() || it % 3 == 0)
+      b.refresh_cumsum();
+
+    const double val = dist(rng) * b.get_total();
+    if (val > 0)
+      CHECK(holds(b.find_upper_bound(val), val));
+
+    // Targets at element boundaries exercise the rounding fallbacks.
+    b.refresh_cumsum();
+    const std::size_t row = rng() % 40;
+    double boundary = b.get_cumsums()[row];
+    for (std::size_t k = row * 25; k < std::min(row * 25 + 25, data.size());
+         k++)
+    {
+      boundary += data[k];
+      if (boundary > 0 && boundary < b.get_total())
+        CHECK(holds(b.find_upper_bound(boundary), boundary));
+    }
+  }
+}
+
+TEST_CASE("Compile-time policies")
+{
+  Data data(100, 1);
+
+  using Lazy = bucket<Data, policy::vector_storage, policy::heavy_first_row_search,
+                      policy::binary_top_search, policy::lazy_refresh>;
+  Lazy lazy(10, 10, data);
+  CHECK(lazy.is_lazy_refresh());
+  CHECK(lazy.is_heavy_first());
+  CHECK_FALSE(lazy.is_float_mirror());
+
+  // Features excluded at compile time have no setter.
+  static_assert(!LazyConfigurable<Lazy>);
+  static_assert(!HeavyFirstConfigurable<Lazy>);
+  static_assert(LazyConfigurable<Default> && HeavyFirstConfigurable<Default>);
+
+  std::vector<double> values(100, 1.0);
+  bucket<std::vector<double>, policy::aligned_storage> aligned(10, 10, values);
+  CHECK(reinterpret_cast<std::uintptr_t>(aligned.get_cumsums().data()) % 64 ==
+        0);
+}
+
+TEST_CASE("Counting stats")
+{
+  Data data(100, 1);
+  bucket<Data, policy::vector_storage, policy::linear_row_search,
+         policy::mirrored_binary_top_search, policy::eager_refresh,
+         policy::counting_stats>
+      b(10, 10, data);
+
+  const auto base = b.get_stats();
+  CHECK(base.refreshes == 1);
+  CHECK(base.rows_refreshed == 10);
+
+  data[35] = 2;
+  b.update_sum_at_row(3);
+  b.refresh_cumsum();
+  CHECK(b.get_stats().updates == base.updates + 1);
+  CHECK(b.get_stats().rows_refreshed == base.rows_refreshed + 7);
+
+  CHECK(b.find_upper_bound(4) == 3);
+  CHECK(b.get_stats().queries == 1);
+  CHECK(b.get_stats().elements_scanned == 4);
+}
+
+TEST_CASE("Incremental rebuild refreshes only from the first changed row")
+{
+  Data data(100, 1);
+  bucket<Data, policy::vector_storage, policy::linear_row_search,
+         policy::mirrored_binary_top_search, policy::eager_refresh,
+         policy::counting_stats>
+      b(10, 10, data);
+
+  // Rows 6 and 8 change without an update, as after a bulk rewrite.
+  data[61] = 3;
+  data[85] = 0;
+  const auto base = b.get_stats();
+  b.begin_rebuild(4);
+  while (!b.rebuild_step(1))
+    ;
+  CHECK(b.get_stats().refreshes == base.refreshes + 1);
+  CHECK(b.get_stats().rows_refreshed == base.rows_refreshed + 4);
+  CHECK(b.get_sums() == Default(10, 10, data).get_sums());
+  CHECK(b.get_cumsums() == Default(10, 10, data).get_cumsums());
+
+  // Nothing changed: the swap refreshes nothing.
+  b.begin_rebuild(10);
+  CHECK(b.rebuild_step(10));
+  CHECK(b.get_stats().refreshes == base.refreshes + 1);
+}
+
+TEST_CASE("Blocked row search falls back on rounding")
+{
+  // The block sum reaches the target, but the running sum rounds below it.
+  const double row[] = {0.39658072616260931, 0.38791074026056105,
+                        0.66974604044704711, 0.93553907270468017, 0.0};
+  const double start = 8.463109183448406;
+  const double val = 10.852885763023304;
+  CHECK(policy::linear_row_search::scan(row, 5, start, val) == 5);
+  CHECK(policy::blocked_row_search<4>::scan(row, 5, start, val) == 3);
+  // A target beyond the row is still not found.
+  CHECK(policy::blocked_row_search<4>::scan(row, 5, start, 11.0) == 5);
+}
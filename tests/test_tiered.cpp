@@ -0,0 +1,105 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN 0
+#include <doctest/doctest.h>
+
+#include <bucket/tiered.hpp>
+#include <random>
+#include <utility>
+#include <vector>
+
+using bucketlib::tiered_bucket;
+
+TEST_CASE("Tiered bucket")
+{
+  const std::size_t n = 1000;
+  std::vector<double> weights(n, 1.0);
+  tiered_bucket<double> t(weights, 8, 256);
+
+  CHECK(t.size() == n);
+  CHECK(t.hot_size() == 0);
+  CHECK(t.get_total() == doctest::Approx(1000.0));
+
+  // Indices spread over all rows that receive almost all updates.
+  const std::vector<std::size_t> hot = {3, 150, 420, 777, 998};
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> weight(0.5, 2.0);
+  for (std::size_t it = 0; it < 2048; it++)
+  {
+    const std::size_t i = it % 20 == 0 ? rng() % n : hot[it % hot.size()];
+    t.set(i, weight(rng));
+  }
+
+  SUBCASE("Frequently updated indices migrate to the hot tier")
+  {
+    for (std::size_t i : hot)
+      CHECK(t.is_hot(i));
+    CHECK(t.hot_size() <= 8);
+  }
+
+  SUBCASE("Translation is transparent")
+  {
+    double total = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+      total += t.get(i);
+    CHECK(t.get_total() == doctest::Approx(total));
+
+    std::vector<double> mass(n, 0.0);
+    const std::size_t steps = 200'000;
+    for (std::size_t s = 0; s < steps; s++)
+    {
+      const double val = total * (static_cast<double>(s) + 0.5) / steps;
+      const std::size_t i = t.find_upper_bound(val);
+      REQUIRE(i < n);
+      mass[i] += total / steps;
+    }
+    for (std::size_t i : hot)
+      CHECK(mass[i] == doctest::Approx(t.get(i)).epsilon(0.01));
+    CHECK(mass[500] == doctest::Approx(t.get(500)).epsilon(0.01));
+  }
+
+  SUBCASE("A target of exactly the hot total stays in the hot tier")
+  {
+    for (std::size_t it = 0; it < 1024; it++)
+      t.set(hot[it % hot.size()], 2.0);
+    double hot_total = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+      if (t.is_hot(i))
+        hot_total += t.get(i);
+    REQUIRE(hot_total > 0.0);
+    CHECK(t.is_hot(t.find_upper_bound(hot_total)));
+  }
+
+  SUBCASE("Copies and moves are independent samplers")
+  {
+    tiered_bucket<double> copy = t;
+    t.set(500, 0.0);
+    t.set(501, 0.0);
+    CHECK(copy.get(500) > 0.0);
+    CHECK(copy.get_total() == doctest::Approx(t.get_total() + copy.get(500) +
+                                              copy.get(501)));
+    // The copy searches its own weights, not the changed ones.
+    const double val = copy.get_total() - 0.5 * copy.get(999);
+    CHECK(copy.find_upper_bound(val) == 999);
+
+    tiered_bucket<double> moved = std::move(copy);
+    CHECK(moved.get(500) > 0.0);
+    CHECK(moved.find_upper_bound(val) == 999);
+    t = moved;
+    CHECK(t.get(500) == moved.get(500));
+    CHECK(t.get_cold().get_total() == moved.get_cold().get_total());
+  }
+
+  SUBCASE("Cooled down indices return to the cold tier")
+  {
+    for (std::size_t it = 0; it < 1024; it++)
+      t.set(10 + it % 4, 1.0);
+    CHECK_FALSE(t.is_hot(hot[0]));
+    CHECK(t.is_hot(10));
+    CHECK(t.get(hot[0]) > 0.0);
+
+    std::size_t sampled_hot = 0;
+    for (std::size_t s = 0; s < 10'000; s++)
+      sampled_hot += t.sample(rng) == 10;
+    CHECK(sampled_hot / 10'000.0 ==
+          doctest::Approx(1.0 / t.get_total()).epsilon(0.5));
+  }
+}